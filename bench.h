@@ -0,0 +1,420 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include "stats.h"
+#include "session.h"
+
+/**
+ * @file bench.h
+ * @brief Synthetic controller input and a loopback sink, to benchmark core_0.1.c headless.
+ *
+ * An injector thread pushes SDL_CONTROLLERAXISMOTION and SDL_CONTROLLERBUTTONDOWN/UP
+ * events with SDL_PushEvent at a fixed rate, so the whole path from the SDL queue to
+ * send() runs exactly as with a real controller, then pushes SDL_QUIT. The sink is a
+ * local TCP or UDP server that reads and throws away what it receives; use
+ * mock_robot.c instead to see the frames.
+ *
+ * Patterns:
+ * - sine: the six axes sweep sine waves of different frequencies;
+ * - jitter: random axes jump between full deflections, the worst case for the filter;
+ * - mash: random buttons pressed and released as fast as possible;
+ * - mix: three sine events for one mash event.
+ *
+ * The injector also replays a session recorded with -w (session.h). In real time,
+ * the recorded controller events are pushed again with their original timing. As
+ * fast as possible, the events that were handled in one loop cycle at recording
+ * time (those between two sent messages) are pushed together and the injector
+ * waits for the main loop to handle them, so the same inputs produce the same
+ * messages, whatever the speed. Only messages sent on timers (UDP repeats, paced
+ * mode) depend on timing.
+ *
+ * The injector and the sink measure their own CPU time so that it can be left out
+ * of the cost per event.
+ *
+ * Header only, like stats.h.
+ */
+
+enum bench_pattern { BENCH_SINE, BENCH_JITTER, BENCH_MASH, BENCH_MIX, BENCH_PATTERN_COUNT };
+
+static const char *bench_pattern_names[BENCH_PATTERN_COUNT] = { "sine", "jitter", "mash", "mix" };
+
+#define BENCH_RATE 1000     // évènements par seconde par défaut
+#define BENCH_SECONDS 5
+#define BENCH_TARGETS_MAX 16 // manettes simulées au plus
+
+struct bench {
+    enum bench_pattern pattern;
+    int rate;                       // évènements injectés par seconde
+    int seconds;                    // durée de l'injection
+    unsigned seed;                  // même graine, même séquence d'évènements
+
+    pthread_t injector;
+    unsigned long long pushed;      // évènements acceptés par la file SDL
+    unsigned long long rejected;    // file SDL pleine : la boucle ne suit plus
+    int targets;                    // manettes simulées, une par robot
+    uint16_t held[BENCH_TARGETS_MAX]; // boutons appuyés par le motif mash, par manette
+
+    const char *replay_path;        // rejeu d'une session au lieu d'un motif
+    struct session_replay replay;
+    int fast;                       // 1 : rejeu sans attendre, 0 : en temps réel
+    atomic_ullong handled;          // évènements manette traités par la boucle principale
+    unsigned long long recorded_messages; // messages envoyés lors de l'enregistrement
+
+    int sink_fd;                    // -1 : pas de puits local
+    int sink_udp;
+    pthread_t sink;
+    atomic_int sink_running;
+    unsigned long long sink_bytes;  // octets reçus par le puits
+
+    uint64_t injector_cpu_ns;       // CPU des threads du banc, hors chemin mesuré
+    uint64_t sink_cpu_ns;
+};
+
+static inline void bench_init(struct bench *bench) {
+    memset(bench, 0, sizeof(*bench));
+    bench->rate = BENCH_RATE;
+    bench->seconds = BENCH_SECONDS;
+    bench->seed = 1;
+    bench->targets = 1;
+    bench->sink_fd = -1;
+}
+
+/**
+ * @brief Parses "pattern[,rate[,seconds]]", e.g. "sine,2000,10".
+ *
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE if the pattern is unknown or a number invalid.
+ */
+static inline int bench_parse(struct bench *bench, const char *arg) {
+    bench_init(bench);
+    size_t len = strcspn(arg, ",");
+    bench->pattern = BENCH_PATTERN_COUNT;
+    for (int i = 0; i < BENCH_PATTERN_COUNT; i++) {
+        if (strlen(bench_pattern_names[i]) == len && strncmp(arg, bench_pattern_names[i], len) == 0) {
+            bench->pattern = i;
+        }
+    }
+    if (bench->pattern == BENCH_PATTERN_COUNT) {
+        return EXIT_FAILURE;
+    }
+    if (arg[len] == ',' && sscanf(arg + len + 1, "%d,%d", &bench->rate, &bench->seconds) < 1) {
+        return EXIT_FAILURE;
+    }
+    return (bench->rate > 0 && bench->rate <= 1000000 && bench->seconds > 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Prepares the replay of a recorded session, given as "file[,fast]".
+ *
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE if the file is not a session log.
+ */
+static inline int bench_parse_replay(struct bench *bench, char *arg) {
+    bench_init(bench);
+    char *comma = strrchr(arg, ',');
+    if (comma != NULL && strcmp(comma + 1, "fast") == 0) {
+        *comma = '\0';
+        bench->fast = 1;
+    }
+    bench->replay_path = arg;
+    return session_replay_open(&bench->replay, arg);
+}
+
+/**
+ * @brief Builds the `n`-th synthetic event of the pattern, `t` seconds after the start.
+ *
+ * With several targets, events go in turn to simulated controllers 0, 1, 2...
+ */
+static inline void bench_event(struct bench *bench, unsigned long long n, double t, SDL_Event *event) {
+    memset(event, 0, sizeof(*event));
+    int target = (int)(n % (unsigned)bench->targets);
+    n /= (unsigned)bench->targets;
+    enum bench_pattern pattern = bench->pattern;
+    if (pattern == BENCH_MIX) {
+        pattern = (n % 4 == 3) ? BENCH_MASH : BENCH_SINE;
+    }
+
+    if (pattern == BENCH_MASH) {
+        int button = rand_r(&bench->seed) % (SDL_CONTROLLER_BUTTON_DPAD_RIGHT + 1);
+        int pressed = (bench->held[target] >> button) & 1;
+        bench->held[target] ^= (uint16_t)(1 << button);
+        event->type = pressed ? SDL_CONTROLLERBUTTONUP : SDL_CONTROLLERBUTTONDOWN;
+        event->cbutton.which = target;
+        event->cbutton.button = button;
+        event->cbutton.state = !pressed;
+        return;
+    }
+
+    int axis;
+    double value; // -1..1 pour les joysticks, 0..1 pour les gâchettes
+    if (pattern == BENCH_SINE) {
+        axis = n % SDL_CONTROLLER_AXIS_MAX;
+        value = sin(2 * M_PI * (0.5 + 0.25 * axis) * t);
+    } else {
+        axis = rand_r(&bench->seed) % SDL_CONTROLLER_AXIS_MAX;
+        value = (rand_r(&bench->seed) & 1) ? 1.0 : -1.0;
+        value -= value * 0.05 * rand_r(&bench->seed) / RAND_MAX; // un peu de bruit près de la butée
+    }
+    if (axis >= SDL_CONTROLLER_AXIS_TRIGGERLEFT) {
+        value = (value + 1) / 2;
+    }
+    event->type = SDL_CONTROLLERAXISMOTION;
+    event->caxis.which = target;
+    event->caxis.axis = axis;
+    event->caxis.value = (Sint16)lrint(value * 32767);
+}
+
+static inline void bench_push(struct bench *bench, SDL_Event *event) {
+    if (SDL_PushEvent(event) > 0) {
+        bench->pushed++;
+    } else {
+        bench->rejected++;
+    }
+}
+
+/**
+ * @brief Called by the main loop after each write, with the number of controller events handled so far.
+ */
+static inline void bench_cycle_done(struct bench *bench, unsigned long long handled) {
+    atomic_store(&bench->handled, handled);
+}
+
+#define BENCH_GROUP 256 // évènements d'un même tour de boucle poussés d'un coup
+
+/**
+ * @brief Pushes a group of events atomically, then waits until the main loop has handled them.
+ */
+static inline void bench_push_group(struct bench *bench, SDL_Event *events, int count) {
+    if (count == 0) {
+        return;
+    }
+    // SDL_PeepEvents() ne date pas les évènements, contrairement à SDL_PushEvent()
+    Uint32 now = SDL_GetTicks();
+    for (int i = 0; i < count; i++) {
+        events[i].common.timestamp = now;
+    }
+    while (SDL_PeepEvents(events, count, SDL_ADDEVENT, 0, 0) < count) {
+        bench->rejected++;
+        SDL_Delay(1);
+    }
+    bench->pushed += count;
+    while (atomic_load(&bench->handled) < bench->pushed) {
+        sched_yield();
+    }
+}
+
+/**
+ * @brief Replays the recorded events. None is dropped: when the SDL queue is full,
+ *        the injector waits for the main loop.
+ */
+static inline void bench_replay(struct bench *bench) {
+    uint64_t start = stats_now_ns();
+    SDL_Event group[BENCH_GROUP];
+    int count = 0;
+    struct session_record record;
+    while (session_replay_next(&bench->replay, &record)) {
+        SDL_Event event;
+        if (!session_record_event(&record, &event)) {
+            if (record.kind == SESSION_SENT) {
+                bench->recorded_messages++;
+                bench_push_group(bench, group, count); // fin d'un tour de boucle enregistré
+                count = 0;
+            }
+            continue;
+        }
+        if (bench->fast) {
+            if (count == BENCH_GROUP) {
+                bench_push_group(bench, group, count);
+                count = 0;
+            }
+            group[count++] = event;
+            continue;
+        }
+        uint64_t due = start + record.t_ns;
+        struct timespec at = { (time_t)(due / 1000000000ull), (long)(due % 1000000000ull) };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, NULL) == EINTR) {
+        }
+        while (SDL_PushEvent(&event) <= 0) {
+            bench->rejected++;
+            SDL_Delay(1);
+        }
+        bench->pushed++;
+    }
+    bench_push_group(bench, group, count);
+}
+
+/**
+ * @brief Pushes `rate` events per second of the pattern for `seconds`.
+ *
+ * Events are pushed in bursts every millisecond, as many as needed to stay on the
+ * target count, so rates far above 1 kHz do not depend on the sleep granularity.
+ */
+static inline void bench_generate(struct bench *bench) {
+    uint64_t start = stats_now_ns();
+    uint64_t end = start + (uint64_t)bench->seconds * 1000000000ull;
+    unsigned long long n = 0;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    for (;;) {
+        uint64_t now = stats_now_ns();
+        if (now >= end) {
+            break;
+        }
+        unsigned long long due = (unsigned long long)((now - start) / 1e9 * bench->rate);
+        while (n < due) {
+            SDL_Event event;
+            bench_event(bench, n, (now - start) / 1e9, &event);
+            bench_push(bench, &event);
+            n++;
+        }
+        next.tv_nsec += 1000000;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+}
+
+/**
+ * @brief Injector thread: generates the pattern or replays the session, then pushes SDL_QUIT.
+ */
+static inline void *bench_injector_thread(void *arg) {
+    struct bench *bench = arg;
+    if (bench->replay_path != NULL) {
+        bench_replay(bench);
+    } else {
+        bench_generate(bench);
+    }
+
+    SDL_Event quit;
+    memset(&quit, 0, sizeof(quit));
+    quit.type = SDL_QUIT;
+    while (SDL_PushEvent(&quit) <= 0) {
+        SDL_Delay(1);
+    }
+    struct timespec cpu;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    bench->injector_cpu_ns = (uint64_t)cpu.tv_sec * 1000000000ull + cpu.tv_nsec;
+    return NULL;
+}
+
+static inline int bench_start(struct bench *bench) {
+    return pthread_create(&bench->injector, NULL, bench_injector_thread, bench) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Sink thread: reads and discards until bench_stop().
+ */
+static inline void *bench_sink_thread(void *arg) {
+    struct bench *bench = arg;
+    char buffer[65536];
+    int fd = bench->sink_fd;
+    if (!bench->sink_udp) {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        while (atomic_load(&bench->sink_running) && poll(&pfd, 1, 100) <= 0) {
+        }
+        fd = atomic_load(&bench->sink_running) ? accept(bench->sink_fd, NULL, NULL) : -1;
+    }
+
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    while (fd >= 0) {
+        int ready = poll(&pfd, 1, 100);
+        if (ready == 0 && !atomic_load(&bench->sink_running)) {
+            break;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0 && !bench->sink_udp) {
+            break; // le client a fermé la connexion
+        }
+        if (n > 0) {
+            bench->sink_bytes += n;
+        }
+    }
+    if (fd >= 0 && fd != bench->sink_fd) {
+        close(fd);
+    }
+    struct timespec cpu;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    bench->sink_cpu_ns = (uint64_t)cpu.tv_sec * 1000000000ull + cpu.tv_nsec;
+    return NULL;
+}
+
+/**
+ * @brief Starts a sink on a free loopback port.
+ *
+ * @param bench (struct bench *) The benchmark.
+ * @param udp (int) 1 for a UDP sink, 0 for TCP.
+ * @param port (int *) Receives the port the sink listens on.
+ *
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE if the socket or the thread could not be created.
+ */
+static inline int bench_sink_start(struct bench *bench, int udp, int *port) {
+    struct sockaddr_in addr = {0};
+    socklen_t addr_len = sizeof(addr);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bench->sink_udp = udp;
+    bench->sink_fd = socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+    if (bench->sink_fd < 0 || bind(bench->sink_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0
+        || (!udp && listen(bench->sink_fd, 1) < 0)
+        || getsockname(bench->sink_fd, (struct sockaddr *)&addr, &addr_len) < 0) {
+        return EXIT_FAILURE;
+    }
+    *port = ntohs(addr.sin_port);
+    atomic_store(&bench->sink_running, 1);
+    return pthread_create(&bench->sink, NULL, bench_sink_thread, bench) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Waits for the injector and the sink to finish.
+ */
+static inline void bench_stop(struct bench *bench) {
+    pthread_join(bench->injector, NULL);
+    if (bench->sink_fd >= 0) {
+        atomic_store(&bench->sink_running, 0);
+        pthread_join(bench->sink, NULL);
+        close(bench->sink_fd);
+    }
+    session_replay_close(&bench->replay);
+}
+
+/**
+ * @brief CPU time spent by the benchmark's own threads, in nanoseconds.
+ */
+static inline uint64_t bench_cpu_ns(const struct bench *bench) {
+    return bench->injector_cpu_ns + bench->sink_cpu_ns;
+}
+
+static inline void bench_print(const struct bench *bench, FILE *out) {
+    if (bench->replay_path != NULL) {
+        fprintf(out, "--- Rejeu de %s (%s) ---\n", bench->replay_path, bench->fast ? "accéléré" : "temps réel");
+        fprintf(out, "  évènements rejoués %llu, attentes sur la file SDL pleine %llu\n", bench->pushed, bench->rejected);
+        fprintf(out, "  messages envoyés à l'enregistrement %llu\n", bench->recorded_messages);
+    } else {
+        fprintf(out, "--- Banc %s, %d évènements/s pendant %d s ---\n", bench_pattern_names[bench->pattern],
+                bench->rate, bench->seconds);
+        fprintf(out, "  injectés %llu, rejetés (file SDL pleine) %llu\n", bench->pushed, bench->rejected);
+    }
+    if (bench->sink_fd >= 0) {
+        fprintf(out, "  octets reçus par le puits %llu\n", bench->sink_bytes);
+    }
+    fprintf(out, "  CPU du banc (injection, puits) %.3f s, exclu du coût par évènement\n", bench_cpu_ns(bench) / 1e9);
+}
+
+#endif // BENCH_H
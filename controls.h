@@ -0,0 +1,233 @@
+#ifndef CONTROLS_H
+#define CONTROLS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * @file controls.h
+ * @brief The single description of every button, axis and text message of the protocol.
+ *
+ * CONTROLS_BUTTONS and CONTROLS_AXES list each input once, with its index and its
+ * name. Everything else is generated from these two lists by the preprocessor:
+ * the FRAME_BTN_* and FRAME_AXIS_* numbers used by the binary frames (frame.h),
+ * the text messages of the old protocol with their lengths, and the text decoder.
+ * The PC encodes with an indexed lookup and the ESP32 decodes with the same tables,
+ * so the two ends cannot drift apart.
+ *
+ * Text messages:
+ * - button pressed: name + "P\n", e.g. "CroixP\n";
+ * - button released: name + "R\n", e.g. "CroixR\n";
+ * - axis: name + ":" + value between -1 and 1 with two decimals + "\n", e.g. "JGX:0.50\n".
+ *
+ * To add an input, add one line to a list; the index must stay the SDL number.
+ *
+ * Header only, like frame.h.
+ */
+
+// X(ID, index = SDL_CONTROLLER_BUTTON_* = bit dans la trame, nom dans le protocole texte)
+#define CONTROLS_BUTTONS(X)         \
+    X(CROIX,     0, "Croix")        \
+    X(ROND,      1, "Rond")         \
+    X(CARRE,     2, "Carre")        \
+    X(TRIANGLE,  3, "Triangle")     \
+    X(SELECT,    4, "Select")       \
+    X(PS,        5, "Ps")           \
+    X(START,     6, "Start")        \
+    X(L3,        7, "L3")           \
+    X(R3,        8, "R3")           \
+    X(L1,        9, "L1")           \
+    X(R1,       10, "R1")           \
+    X(HAUT,     11, "Haut")         \
+    X(BAS,      12, "Bas")          \
+    X(GAUCHE,   13, "Gauche")       \
+    X(DROITE,   14, "Droite")       \
+    X(TOUCHPAD, 15, "Touchpad")
+
+// X(ID, index = SDL_CONTROLLER_AXIS_*, nom, 1 pour une gâchette)
+#define CONTROLS_AXES(X)            \
+    X(JGX, 0, "JGX", 0) /* Joystick gauche X */ \
+    X(JGY, 1, "JGY", 0) /* Joystick gauche Y */ \
+    X(JDX, 2, "JDX", 0) /* Joystick droit X */  \
+    X(JDY, 3, "JDY", 0) /* Joystick droit Y */  \
+    X(GG,  4, "GG",  1) /* Gâchette gauche */   \
+    X(GD,  5, "GD",  1) /* Gâchette droite */
+
+// Numéro de bit de chaque bouton, identique aux SDL_CONTROLLER_BUTTON_*
+enum frame_button {
+#define X(id, index, name) FRAME_BTN_##id = index,
+    CONTROLS_BUTTONS(X)
+#undef X
+    FRAME_BTN_COUNT
+};
+
+// Index de chaque axe, identique aux SDL_CONTROLLER_AXIS_*
+enum frame_axis {
+#define X(id, index, name, trigger) FRAME_AXIS_##id = index,
+    CONTROLS_AXES(X)
+#undef X
+    FRAME_AXIS_COUNT
+};
+
+/**
+ * @brief A text message and its length, known at compile time.
+ */
+struct control_text {
+    const char *text;
+    uint8_t len;
+};
+
+#define CONTROL_TEXT(s) { s, sizeof(s) - 1 }
+
+static const struct control_text control_press_text[FRAME_BTN_COUNT] = {
+#define X(id, index, name) [FRAME_BTN_##id] = CONTROL_TEXT(name "P\n"),
+    CONTROLS_BUTTONS(X)
+#undef X
+};
+
+static const struct control_text control_release_text[FRAME_BTN_COUNT] = {
+#define X(id, index, name) [FRAME_BTN_##id] = CONTROL_TEXT(name "R\n"),
+    CONTROLS_BUTTONS(X)
+#undef X
+};
+
+static const struct control_text control_button_name[FRAME_BTN_COUNT] = {
+#define X(id, index, name) [FRAME_BTN_##id] = CONTROL_TEXT(name),
+    CONTROLS_BUTTONS(X)
+#undef X
+};
+
+static const struct control_text control_axis_prefix[FRAME_AXIS_COUNT] = {
+#define X(id, index, name, trigger) [FRAME_AXIS_##id] = CONTROL_TEXT(name ":"),
+    CONTROLS_AXES(X)
+#undef X
+};
+
+static const uint8_t control_axis_trigger[FRAME_AXIS_COUNT] = {
+#define X(id, index, name, trigger) [FRAME_AXIS_##id] = trigger,
+    CONTROLS_AXES(X)
+#undef X
+};
+
+#define CONTROLS_TEXT_MAX 16 // plus long message texte, "\n" compris
+
+/**
+ * @brief Writes the text message of an axis, "NAME:%.2f\n" of value / 2^15.
+ *
+ * Integer formatting of the hundredths, rounded like printf: same output as
+ * snprintf() without parsing a format string.
+ *
+ * @param axis (int) Axis index, below FRAME_AXIS_COUNT.
+ * @param value (int16_t) Raw axis value.
+ * @param out (char *) Destination, at least CONTROLS_TEXT_MAX bytes.
+ *
+ * @return The number of characters written.
+ */
+static inline size_t controls_format_axis(int axis, int16_t value, char *out) {
+    const struct control_text *prefix = &control_axis_prefix[axis];
+    memcpy(out, prefix->text, prefix->len);
+    char *p = out + prefix->len;
+
+    // Centièmes arrondis au plus proche, à égalité vers le pair comme printf
+    int32_t scaled = (value < 0 ? -(int32_t)value : value) * 100;
+    int32_t hundredths = scaled >> 15;
+    int32_t rest = scaled & 0x7FFF;
+    if (rest > 0x4000 || (rest == 0x4000 && (hundredths & 1))) {
+        hundredths++;
+    }
+    if (value < 0) {
+        *p++ = '-';
+    }
+    *p++ = (char)('0' + hundredths / 100);
+    *p++ = '.';
+    *p++ = (char)('0' + hundredths / 10 % 10);
+    *p++ = (char)('0' + hundredths % 10);
+    *p++ = '\n';
+    return (size_t)(p - out);
+}
+
+enum control_kind { CONTROL_PRESS, CONTROL_RELEASE, CONTROL_AXIS };
+
+/**
+ * @brief A decoded text message.
+ */
+struct control_message {
+    enum control_kind kind;
+    int index;          // FRAME_BTN_* ou FRAME_AXIS_*
+    int16_t value;      // axes : valeur brute, -32768..32767
+};
+
+/**
+ * @brief Reference text decoder: parses one message, with or without its "\n".
+ *
+ * @param line (const char *) The message, not necessarily NUL-terminated.
+ * @param len (size_t) Its length.
+ * @param out (struct control_message *) Decoded message, valid only when 1 is returned.
+ *
+ * @return Returns 1 if the message is known, 0 otherwise.
+ */
+static inline int controls_decode_text(const char *line, size_t len, struct control_message *out) {
+    if (len > 0 && line[len - 1] == '\n') {
+        len--;
+    }
+    if (len < 2) {
+        return 0;
+    }
+
+    const char *colon = memchr(line, ':', len);
+    if (colon != NULL) {
+        size_t name_len = (size_t)(colon - line) + 1;
+        for (int i = 0; i < FRAME_AXIS_COUNT; i++) {
+            if (control_axis_prefix[i].len != name_len || memcmp(line, control_axis_prefix[i].text, name_len) != 0) {
+                continue;
+            }
+            // Valeur "[-]e.cc" lue en centièmes : pas de virgule flottante côté ESP32
+            const char *p = colon + 1, *end = line + len;
+            int negative = p < end && *p == '-';
+            p += negative;
+            int32_t whole = 0, frac = 0;
+            int digits = 0, decimals = 0;
+            for (; p < end && *p >= '0' && *p <= '9' && digits < 3; p++, digits++) {
+                whole = whole * 10 + (*p - '0');
+            }
+            if (p < end && *p == '.') {
+                for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++) {
+                    if (decimals < 2) {
+                        frac = frac * 10 + (*p - '0');
+                        decimals++;
+                    }
+                }
+            }
+            if (p != end || digits == 0) {
+                return 0;
+            }
+            for (; decimals < 2; decimals++) {
+                frac *= 10;
+            }
+            int32_t value = ((whole * 100 + frac) * 32768 + 50) / 100;
+            value = negative ? -value : value;
+            out->kind = CONTROL_AXIS;
+            out->index = i;
+            out->value = (int16_t)(value > 32767 ? 32767 : value < -32768 ? -32768 : value);
+            return 1;
+        }
+        return 0;
+    }
+
+    char action = line[len - 1];
+    if (action != 'P' && action != 'R') {
+        return 0;
+    }
+    for (int i = 0; i < FRAME_BTN_COUNT; i++) {
+        if (control_button_name[i].len == len - 1 && memcmp(line, control_button_name[i].text, len - 1) == 0) {
+            out->kind = action == 'P' ? CONTROL_PRESS : CONTROL_RELEASE;
+            out->index = i;
+            out->value = 0;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+#endif // CONTROLS_H
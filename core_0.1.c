@@ -1,435 +1,3053 @@
+#define _GNU_SOURCE // pthread_setaffinity_np, CPU_SET
 #include <stdlib.h>
 #include <SDL2/SDL.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
-// gcc -o core.exe core_X.x.c -lSDL2
-// sudo ./core.exe
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sched.h>
+#include <malloc.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+#include "frame.h"
+#include "stats.h"
+#include "bench.h"
+#include "session.h"
+#include "inject.h"
+// gcc -o core.exe core_X.x.c -lSDL2 -lpthread -lm -lrt
+// sudo ./core.exe [-t] [-r hz] [-u] [-z joy,gach] [-c expo] [-s delta] [-o stats.csv] [-a ip[:port]] [-m robots.conf] [-g hz] [-A smax[,hzmin]] [-R prio] [-C cpu] [-i nom[,bouton]] [-H ms[,ms]] [-b motif[,hz[,s]]] [-w session.log] [-p session.log[,fast]]
 
 #define PORT 8080
 #define SERVER_IP "192.168.4.1" // Default IP for ESP32 in AP mode
 
+// Redondance des appuis : un changement de bouton part dans BTN_REPEAT trames
+#define BTN_REPEAT 3
+#define BTN_REPEAT_MS 10 // intervalle entre les répétitions en mode direct UDP
+#define MAX_LINKS 16 // paires manette/robot servies par un seul processus
+_Static_assert(MAX_LINKS <= INJECT_ROBOTS, "le segment d'injection doit décrire tous les robots");
+
+// Connexion TCP : file d'envoi bornée et reconnexion automatique
+#define OUT_QUEUE_SIZE 4096 // octets en attente au plus, au-delà la liaison est bloquée
+#define LINK_STALL_MS 1000 // file non vidée depuis plus longtemps : la connexion est refaite
+#define CONNECT_WAIT_MS 1000 // attente de la connexion au lancement, ensuite elle se termine en tâche de fond
+#define RECONNECT_MIN_MS 100 // premier délai avant une nouvelle tentative, doublé à chaque échec
+#define RECONNECT_MAX_MS 2000
+
+// Retour du robot : télémétrie traduite en vibrations, LED et ligne d'état
+#define RX_BUFFER_SIZE 4096
+#define BATTERY_LOW_PCT 20 // en dessous, LED orange
+#define CURRENT_RUMBLE_MA 3000 // courant moteur à partir duquel la manette vibre
+#define CURRENT_FULL_MA 10000 // courant de la vibration maximale
+#define LOAD_RUMBLE_MS 500 // durée d'une vibration de charge, renouvelée tant que les moteurs forcent
+#define FAULT_RUMBLE_MS 400 // vibration forte à l'apparition d'un défaut
+#define STATUS_MS 200 // rafraîchissement de la ligne d'état dans un terminal
+#define STATUS_LOG_MS 1000 // et quand la sortie est un fichier
+
+// Capteurs de mouvement (-g) : plusieurs échantillons par trame, jamais au détriment des commandes
+#define MOTION_MAX_HZ 1000
+#define MOTION_MAX_AGE_MS 20 // le plus vieil échantillon d'un lot n'attend pas plus longtemps
+#define MOTION_OUT_FRAMES 4 // trames de mouvement prêtes à partir à la fin du tour, au plus
+#define MOTION_BACKLOG 2048 // octets pas encore acquittés par le robot au-delà desquels le mouvement est sauté
+
+// Injection locale (-i) : des processus du poste écrivent des états fusionnés à ceux de la manette
+#define INJECT_POLL_MS 2 // mode direct : relecture des slots tant qu'un processus en tient un
+#define INJECT_STATUS_MS 200 // messages de prise et de perte de la main
+
+// Battement de cœur (-H) : la liaison n'est jamais muette, un robot muet se voit vite
+#define HEARTBEAT_MIN_MS 5
+#define HEARTBEAT_REFRESH 10 // par défaut, l'état complet repart tous les 10 battements
+#define HEARTBEAT_DEAD 4 // battements sans acquittement du robot : la liaison est morte
+// Le chien de garde du robot ne connaît que FRAME_WATCHDOG_MS : il ne doit pas partir entre deux battements
+#define HEARTBEAT_MAX_MS (FRAME_WATCHDOG_MS / HEARTBEAT_DEAD)
+
+// Qualité de la liaison, mesurée par les acquittements des trames d'état, et adaptation (-A)
+#define QUALITY_RING 1024 // trames d'état dont l'heure d'envoi est retenue
+#define QUALITY_MS 100 // période de l'estimation et de l'adaptation
+#define QUALITY_LOSS_MIN_MS 100 // sans acquittement depuis 4 RTT et au moins ce délai, une trame est perdue
+#define QUALITY_MIN_WINDOW_MS 10000 // RTT minimal retenu sur cette fenêtre, base de l'attente en file
+#define QUALITY_DELAY_MS 20 // attente en file au-delà de laquelle la liaison est encombrée
+#define QUALITY_CLEAN_MS 5 // et en deçà de laquelle elle est dégagée
+#define QUALITY_LOSS_PCT 5 // de même pour les pertes
+#define QUALITY_CLEAN_PCT 1
+
+// Mode temps réel (-R, -C)
+#define REALTIME_STACK_PREFAULT (256 * 1024) // pile de la boucle principale touchée d'avance
+
+/**
+ * @brief Response of one kind of axis (sticks or triggers).
+ *
+ * - deadzone: below this fraction of full scale the output is 0. It is radial for
+ *   the sticks (applied to the X/Y vector length) and linear for the triggers.
+ * - hysteresis: once in the deadzone, the input must exceed deadzone + hysteresis
+ *   to leave it, so a stick resting on the edge does not flicker.
+ * - expo: response curve applied after the deadzone, output = input^expo.
+ *   1 is linear, above 1 gives finer control near the centre.
+ */
+struct axis_config {
+    float deadzone;
+    float hysteresis;
+    float expo;
+};
+
+/**
+ * @brief Persistent per-axis processing state of one controller.
+ *
+ * Raw SDL values go in, shaped values come out, and an axis is only reported when
+ * its shaped value moved by at least `delta` (fraction of full scale) since it was
+ * last sent. Returning to 0 and reaching full scale are always reported, so the
+ * robot never stays slightly off centre because of the suppression.
+ */
+struct axis_filter {
+    struct axis_config stick;
+    struct axis_config trigger;
+    float delta;
+    int16_t raw[FRAME_AXIS_COUNT];    // dernières valeurs brutes SDL
+    int16_t sent[FRAME_AXIS_COUNT];   // dernières valeurs envoyées
+    int resting[4];                   // joystick gauche, joystick droit, L2, R2 dans la zone morte
+};
+
+#define AXIS_MAX 32767
+
+/**
+ * @brief Text-protocol messages produced during one loop cycle, sent in one writev.
+ *
+ * Button messages are kept in order. Axes only keep their latest value: moving the
+ * same stick ten times in one cycle sends one line.
+ */
+struct out_batch {
+    char text[256];                   // messages des boutons, dans l'ordre
+    size_t text_len;
+    unsigned axis_dirty;              // bit n : l'axe n a une nouvelle valeur
+    int16_t axis[FRAME_AXIS_COUNT];
+};
+
+/**
+ * @brief Controller state shared between the event loop and the sender thread.
+ *
+ * Protected by a seqlock: the event loop is the only writer and never waits, the
+ * sender thread retries its copy if a write happened in the middle of it. Only the
+ * latest state is kept, so a burst of events costs nothing more than one write each.
+ */
+struct shared_state {
+    atomic_uint seq;                // impair pendant une écriture
+    struct controller_state state;
+    uint16_t taps;                  // boutons relâchés avant d'avoir été publiés
+    uint64_t changed_ns;            // instant du premier changement non publié
+};
+
+/**
+ * @brief Stages timed between a controller event and the return of send().
+ *
+ * - event_to_dispatch: SDL event timestamp to its handling in main() (SDL timestamps
+ *   are in milliseconds, so this one has a 1 ms resolution);
+ * - dispatch_to_encode: first change of the state to its frame being encoded,
+ *   which includes waiting for the end of the loop cycle or the next paced tick;
+ * - encode_to_send: the send system call itself;
+ * - dispatch_to_send: the two previous stages together.
+ */
+enum stage { STAGE_EVENT, STAGE_ENCODE, STAGE_SEND, STAGE_TOTAL, STAGE_COUNT };
+
+static const char *stage_names[STAGE_COUNT] = {
+    "event_to_dispatch", "dispatch_to_encode", "encode_to_send", "dispatch_to_send"
+};
+
+/**
+ * @brief Latency histograms and traffic counters of a link.
+ *
+ * Each field has a single writer (the main loop, or the sender thread in paced
+ * mode), and they are read without locking: a report printed while sending may be
+ * off by one message.
+ */
+struct link_stats {
+    struct histogram stage[STAGE_COUNT];
+    unsigned long long events;      // évènements SDL traités
+    unsigned long long messages;    // trames ou lignes de texte envoyées
+    unsigned long long bytes;
+    unsigned long long writes;      // appels système d'envoi
+    unsigned long long blocked;     // envois que la socket n'a pas pris en entier, reste mis en file
+    unsigned long long superseded;  // états non envoyés car remplacés par un plus récent
+    unsigned long long disconnects; // connexions perdues puis refaites
+    unsigned long long telemetry;   // trames de télémétrie reçues et retenues
+    unsigned long long rx_invalid;  // octets reçus ignorés pour se resynchroniser
+    unsigned long long motion_frames;  // trames de mouvement envoyées (boucle principale seulement)
+    unsigned long long motion_samples;
+    unsigned long long motion_bytes;
+    unsigned long long motion_dropped; // trames de mouvement sautées pour laisser passer les commandes
+    struct histogram rtt;           // aller-retour trame d'état -> acquittement (boucle principale)
+    struct histogram interval;      // entre deux envois successifs, la gigue de la boucle d'envoi
+    uint64_t last_send_ns;
+    unsigned long long acks;        // trames d'état acquittées
+    unsigned long long lost;        // trames d'état jamais acquittées
+    unsigned long long injected;    // trames d'état portant au moins une entrée injectée (-i)
+    unsigned long long heartbeats;  // trames de battement envoyées (-H)
+    unsigned long long link_lost;   // fois où le robot a cessé de répondre
+    uint64_t start_ns;
+};
+
+/**
+ * @brief Bytes that the socket did not take yet, sent in order when it becomes writable.
+ *
+ * Only what must arrive goes here: the end of a partially written message and the
+ * button edges. A state that is merely newer than the previous one is never queued:
+ * the link remembers that the robot is behind and sends the latest state once the
+ * queue is empty. The queue is therefore bounded by the button activity, not by the
+ * event rate, and an overflow means the robot is not reading any more.
+ */
+struct out_queue {
+    uint8_t data[OUT_QUEUE_SIZE];
+    size_t len;
+    Uint32 since;                   // SDL_GetTicks() quand la file a cessé d'être vide
+};
+
+/**
+ * @brief Receive buffer of a link, parsed in place.
+ *
+ * recv() writes straight after the bytes already there and frames are decoded where
+ * they lie, without being copied out first. Only the tail of an incomplete frame,
+ * shorter than FRAME_MAX_SIZE, is moved back to the start before the next recv(),
+ * so hundreds of telemetry frames per second cost a few hundred bytes of copying.
+ */
+struct rx_buffer {
+    uint8_t data[RX_BUFFER_SIZE];
+    size_t len;
+};
+
+/**
+ * @brief Averages the controller's gyroscope and accelerometer down to the rate of the motion stream.
+ *
+ * SDL reports each sensor separately, at the controller's own rate (up to 1 kHz).
+ * Readings are summed over windows of 1/motion_hz s of controller time; when a reading
+ * falls after the window, the averages of both sensors become one sample. A sensor
+ * that reported nothing in a window keeps its previous value.
+ */
+struct motion_filter {
+    uint64_t period_us;
+    uint64_t window_end_us;         // fin de la fenêtre en cours, horloge de la manette
+    uint64_t last_us;               // dernière lecture de la fenêtre
+    float sum[2][3];                // gyroscope, accéléromètre
+    int count[2];
+    int16_t last[2][3];             // valeurs quantifiées du dernier échantillon
+};
+
+/**
+ * @brief Link quality measured from the ACK frames of the robot, and the operating point derived from it.
+ *
+ * The send time of each state frame is kept by sequence number in a ring. An ACK
+ * gives an RTT sample, smoothed like TCP does (srtt, and rttvar as the jitter); a
+ * frame not acknowledged within max(4 srtt, QUALITY_LOSS_MIN_MS) counts as lost. The
+ * queueing delay is srtt minus the smallest RTT of the last QUALITY_MIN_WINDOW_MS.
+ *
+ * With -A, every QUALITY_MS the link backs off quickly when it is congested (queueing
+ * delay or loss above their limits) and comes back slowly when it is clean: `level`
+ * goes from 0, the finest point (-s delta, -r hz), to 1, the coarsest (-A smax,hzmin).
+ *
+ * The ring is written by whichever thread sends the state frames; each entry is one
+ * atomic word, (seq << 48) | send time in µs. Everything else belongs to the main loop.
+ */
+struct link_quality {
+    atomic_ullong sent[QUALITY_RING];
+    uint64_t done[QUALITY_RING];    // entrée déjà comptée : perdue, ou acquittée avec QUALITY_ACKED
+    double srtt_us;
+    double rttvar_us;
+    double min_rtt_us;              // RTT minimal de la fenêtre précédente et de celle en cours
+    double window_min_us;
+    Uint32 window_at;               // fin de la fenêtre en cours
+    double loss;                    // moyenne glissante des pertes, 0 à 1
+    int has_rtt;                    // 1 : au moins un acquittement depuis la connexion
+    Uint32 next_at;                 // prochaine estimation
+    
+    // Adaptation (-A) : limites et point de fonctionnement
+    int adaptive;
+    float delta_min, delta_max;     // sensibilité des axes, en fraction de la pleine échelle
+    int hz_min;                     // fréquence d'envoi la plus basse, la plus haute est -r
+    float level;                    // 0 : point le plus fin, 1 : le plus grossier
+    int backed_off;                 // 1 : encombrement signalé, pas encore revenu au point le plus fin
+};
+
+#define QUALITY_TIME_MASK ((1ull << 47) - 1)
+#define QUALITY_ACKED (1ull << 47)
+
+// État de la connexion d'un robot
+enum link_status { LINK_DOWN, LINK_CONNECTING, LINK_UP };
+
+/**
+ * @brief Everything needed to drive one robot from one controller.
+ *
+ * The controller state is kept here as a full snapshot so that the binary protocol
+ * (see frame.h) can send it in a single fixed-size frame.
+ */
+struct link {
+    char name[32];                  // nom du robot dans les messages et les statistiques
+    struct sockaddr_in addr;        // adresse du robot
+    int sock;                       // socket non bloquante vers l'ESP32, -1 sans connexion
+    atomic_int status;              // enum link_status, lu aussi par le thread d'envoi
+    pthread_mutex_t io_lock;        // mode cadencé : la socket est partagée avec le thread d'envoi
+    struct out_queue queue;         // ce que la socket n'a pas encore pris
+    int stale;                      // 1 : des états ont été sautés, le plus récent part quand la file se vide
+    uint16_t queued_buttons;        // boutons de la dernière trame confiée à la socket
+    int watch_out;                  // 1 : le watcher signale aussi quand la socket est prête en écriture
+    int backoff_ms;                 // délai avant la prochaine tentative de connexion, 0 si connecté
+    Uint32 reconnect_at;            // échéance SDL_GetTicks() de cette tentative
+    
+    // Réception : télémétrie du robot, rendue sur la manette (boucle principale seulement)
+    struct rx_buffer rx;
+    struct frame_rx telemetry_rx;   // numéros de la télémétrie : une trame UDP en retard est ignorée
+    struct telemetry telemetry;     // dernier état reçu du robot
+    int has_telemetry;
+    uint16_t signaled_faults;       // défauts déjà signalés par une vibration forte
+    int rumble_level;               // vibration de charge en cours, 0 à 4, -1 pour celle d'un défaut
+    Uint32 rumble_until;            // échéance SDL_GetTicks() de cette vibration
+    uint32_t led;                   // couleur actuelle de la LED, 0xRRGGBB
+    
+    // Capteurs de mouvement (-g) : lots d'échantillons, envoyés après l'état de la manette
+    int motion_hz;                  // 0 : pas de flux de mouvement
+    struct motion_filter motion_filter;
+    struct motion motion;           // lot en cours, et dernier état du pavé tactile
+    uint64_t motion_base_us;        // horodatage complet du premier échantillon du lot
+    int motion_touched;             // 1 : le pavé tactile a changé depuis la dernière trame
+    Uint32 motion_since;            // SDL_GetTicks() quand le lot a cessé d'être vide
+    uint16_t motion_seq;            // numéro de la prochaine trame de mouvement
+    uint8_t motion_out[MOTION_OUT_FRAMES * FRAME_MAX_SIZE]; // trames encodées pour la fin du tour
+    size_t motion_out_len;
+    int motion_out_frames;
+    int motion_out_samples;
+    
+    struct link_quality quality;    // aller-retour et pertes mesurés, adaptation (-A)
+    
+    // Injection locale (-i) : états écrits par d'autres processus, fusionnés à l'envoi
+    struct inject_shm *inject;      // NULL sans injection
+    int inject_robot;               // index du robot dans le segment
+    int takeover_button;            // bouton de reprise manuelle, jamais transmis au robot
+    struct controller_state inject_last; // mode direct : dernier état fusionné publié
+    unsigned inject_active;         // slots frais qui commandent quelque chose, pour les messages
+    int inject_takeover;            // 1 : reprise manuelle en cours
+    Uint32 inject_at;               // prochains messages de l'injection
+    
+    // Battement de cœur (-H) : trame minimale quand rien ne part, silence du robot détecté
+    int heartbeat_ms;               // 0 : pas de battement
+    int refresh_ms;                 // mode direct : l'état complet repart au moins à cet intervalle
+    Uint32 sent_at;                 // mode direct : dernière trame d'état ou de battement
+    Uint32 refresh_at;              // mode direct : dernière trame d'état
+    Uint32 heard_at;                // dernier acquittement reçu du robot
+    int dead;                       // 1 : le robot ne répond plus, manette en rouge
+    
+    SDL_GameController *controller; // manette attribuée, NULL s'il n'y en a pas
+    SDL_JoystickID joystick;        // identifiant SDL de cette manette, -1 sans manette
+    int texte;                      // 1 : ancien protocole texte "NOM:valeur\n"
+    int udp;                        // 1 : trames en datagrammes UDP au lieu de TCP
+    uint16_t seq;                   // numéro de la prochaine trame
+    struct controller_state state;  // dernier état connu de la manette
+    struct axis_filter filter;      // mise en forme des axes et dernières valeurs envoyées
+    
+    // Tout ce qui change pendant un tour de boucle part en une seule écriture
+    int dirty;                      // 1 : l'état a changé depuis la dernière écriture
+    uint16_t cycle_press;           // boutons appuyés pendant ce tour (mode direct TCP)
+    struct out_batch batch;         // messages du protocole texte en attente
+    uint64_t changed_ns;            // instant du premier changement de ce tour
+    struct link_stats stats;
+    struct session_log *log;        // enregistrement de la session (-w), NULL sinon
+    
+    // Mode cadencé (-r) : la boucle SDL écrit l'état, le thread d'envoi le publie
+    int rate_hz;                    // 0 : envoi direct à chaque évènement
+    atomic_int send_hz;             // fréquence actuelle, rate_hz ou moins avec -A
+    uint64_t send_at_ns;            // propre au thread d'envoi : prochain envoi de ce robot
+    struct shared_state shared;
+    atomic_uint published;          // version de l'état partagé envoyée en dernier
+    unsigned sent_version;          // propres au thread d'envoi : dernière version lue
+    uint16_t sent_buttons;          // boutons de la dernière trame envoyée
+    struct controller_state sent_state; // -H : dernier état complet envoyé
+    int same_frames;                // et nombre de trames qui l'ont porté
+    uint64_t refresh_ns;            // -H : instant de cette dernière trame d'état
+    atomic_int resend;              // -H : la prochaine trame d'état, complète, suit un battement
+    int tap_frames;                 // et trames déjà envoyées avec les appuis brefs
+    unsigned press_version[FRAME_BTN_COUNT]; // version où chaque bouton a été appuyé
+    uint16_t taps;
+    unsigned taps_version;
+    
+    // Mode direct UDP : répétition de l'état après un changement de bouton
+    uint16_t repeat_press;          // boutons appuyés pendant la fenêtre de répétition
+    int repeat_left;
+    Uint32 repeat_at;               // échéance SDL_GetTicks() de la prochaine répétition
+};
+
+/**
+ * @brief Every controller/robot pair served by the process.
+ *
+ * Each link is a robot from the command line or the config file (-m). Controllers
+ * are given to the first robot without one as they are plugged in, and events are
+ * routed by their SDL_JoystickID. One main loop and, in paced mode, one sender
+ * thread serve all the links.
+ */
+struct fleet {
+    struct link links[MAX_LINKS];
+    int count;
+    pthread_t sender;               // thread d'envoi cadencé, commun à tous les robots
+    atomic_int sender_running;
+    uint64_t tool_cpu_ns;           // CPU des threads du banc (-b), exclu du coût par évènement
+    struct histogram tick_late;     // mode cadencé : retard du réveil du thread d'envoi sur son échéance
+    Uint32 status_at;               // prochaine ligne d'état
+    unsigned long long status_telemetry; // trames de télémétrie déjà affichées
+};
+
+/**
+ * @brief Writes a new controller state into the seqlock. Never blocks.
+ *
+ * @param shared (struct shared_state *) The shared state, written by a single thread only.
+ * @param state (const struct controller_state *) The new state.
+ * @param taps (uint16_t) Buttons to report as pressed even though they were released.
+ * @param changed_ns (uint64_t) When the state started to differ from the published one.
+ *
+ * @return The version of the state just written.
+ */
+unsigned shared_state_write(struct shared_state *shared, const struct controller_state *state, uint16_t taps,
+                           uint64_t changed_ns) {
+    unsigned seq = atomic_load_explicit(&shared->seq, memory_order_relaxed);
+    atomic_store_explicit(&shared->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    shared->state = *state;
+    shared->taps = taps;
+    shared->changed_ns = changed_ns;
+    atomic_store_explicit(&shared->seq, seq + 2, memory_order_release);
+    return seq + 2;
+}
+
+/**
+ * @brief Reads a consistent copy of the controller state from the seqlock.
+ *
+ * @param shared (struct shared_state *) The shared state.
+ * @param state (struct controller_state *) Receives the copy.
+ * @param taps (uint16_t *) Receives the buttons released before being published.
+ * @param changed_ns (uint64_t *) Receives when the state started to change.
+ *
+ * @return The version of the copied state.
+ */
+unsigned shared_state_read(struct shared_state *shared, struct controller_state *state, uint16_t *taps,
+                          uint64_t *changed_ns) {
+    unsigned before, after;
+    do {
+        before = atomic_load_explicit(&shared->seq, memory_order_acquire);
+        *state = shared->state;
+        *taps = shared->taps;
+        *changed_ns = shared->changed_ns;
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&shared->seq, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    return before;
+}
+
+/**
+ * @brief Skips the first `n` bytes of an iovec array.
+ */
+void iov_advance(struct iovec **iov, int *iovcnt, size_t n) {
+    while (*iovcnt > 0 && n >= (*iov)->iov_len) {
+        n -= (*iov)->iov_len;
+        (*iov)++;
+        (*iovcnt)--;
+    }
+    if (*iovcnt > 0) {
+        (*iov)->iov_base = (char *)(*iov)->iov_base + n;
+        (*iov)->iov_len -= n;
+    }
+}
+
+/**
+ * @brief Shuts the socket of a link down after a write error or a stall.
+ *
+ * Only the main loop closes and reconnects sockets: the watcher reports the socket as
+ * closed and the main loop then does it, whichever thread found the problem.
+ */
+void link_fail(struct link *link) {
+    shutdown(link->sock, SHUT_RDWR);
+}
+
+/**
+ * @brief Tells if the queue of the link has not been emptied for LINK_STALL_MS.
+ */
+int link_stalled(struct link *link) {
+    return link->queue.len > 0 && (int)(SDL_GetTicks() - link->queue.since) >= LINK_STALL_MS;
+}
+
+/**
+ * @brief Appends buffers to the queue of the link.
+ *
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE if they do not fit.
+ */
+int queue_append(struct out_queue *queue, const struct iovec *iov, int iovcnt) {
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        len += iov[i].iov_len;
+    }
+    if (queue->len + len > sizeof(queue->data)) {
+        return EXIT_FAILURE;
+    }
+    if (queue->len == 0) {
+        queue->since = SDL_GetTicks();
+    }
+    for (int i = 0; i < iovcnt; i++) {
+        memcpy(queue->data + queue->len, iov[i].iov_base, iov[i].iov_len);
+        queue->len += iov[i].iov_len;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Sends as much of the queue of the link as the socket takes, without waiting.
+ *
+ * When the queue becomes empty after states were skipped, the link is marked dirty so
+ * that the end of the loop cycle sends the latest state.
+ *
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE if the connection failed.
+ */
+int link_drain(struct link *link) {
+    struct out_queue *queue = &link->queue;
+    if (queue->len == 0) {
+        return EXIT_SUCCESS;
+    }
+    ssize_t sent = send(link->sock, queue->data, queue->len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    link->stats.writes++;
+    if (sent < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return EXIT_SUCCESS;
+        }
+        link_fail(link);
+        return EXIT_FAILURE;
+    }
+    memmove(queue->data, queue->data + sent, queue->len - (size_t)sent);
+    queue->len -= (size_t)sent;
+    if (queue->len == 0 && link->stale) {
+        link->stale = 0;
+        link->dirty = 1; // l'état le plus récent part à la fin du tour
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Writes messages that must arrive to the link socket, without ever waiting.
+ *
+ * They are sent in one system call. What the socket does not take is queued and sent
+ * by link_drain() when the socket becomes writable again; while the queue is not
+ * empty, new messages go behind it to keep the order. Over UDP nothing is queued: a
+ * datagram the socket refuses is lost like one lost on the air, and the next state
+ * replaces it.
+ *
+ * @param link (struct link *) The link to send on.
+ * @param iov (struct iovec *) The buffers to send. Modified.
+ * @param iovcnt (int) Number of buffers.
+ * @param messages (int) Number of protocol messages in the buffers, for the stats.
+ *
+ * @return Returns EXIT_SUCCESS if everything was sent or queued, otherwise EXIT_FAILURE
+ *         and the socket is shut down (see link_fail()).
+ */
+int link_writev(struct link *link, struct iovec *iov, int iovcnt, int messages) {
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        len += iov[i].iov_len;
+    }
+    if (len == 0) {
+        return EXIT_SUCCESS;
+    }
+    for (int i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len > 0) {
+            session_log_record(link->log, SESSION_SENT, iov[i].iov_base, iov[i].iov_len);
+        }
+    }
+    link->stats.bytes += len;
+    link->stats.messages += messages;
+    
+    ssize_t sent = 0;
+    if (link->queue.len == 0) {
+        struct msghdr msg = { .msg_iov = iov, .msg_iovlen = iovcnt };
+        sent = sendmsg(link->sock, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        link->stats.writes++;
+        if (sent < 0) {
+            if (link->udp) {
+                link->stats.superseded += messages;
+                return EXIT_SUCCESS;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                link_fail(link);
+                return EXIT_FAILURE;
+            }
+            sent = 0;
+        }
+        if ((size_t)sent == len) {
+            return EXIT_SUCCESS;
+        }
+        link->stats.blocked++;
+    }
+    
+    // Tampon d'envoi plein : le reste attend son tour, la boucle ne s'arrête pas
+    iov_advance(&iov, &iovcnt, (size_t)sent);
+    if (queue_append(&link->queue, iov, iovcnt) != EXIT_SUCCESS) {
+        link_fail(link); // le robot ne lit plus rien
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int link_write(struct link *link, const void *buf, size_t len, int messages) {
+    struct iovec iov = { (void *)buf, len };
+    return link_writev(link, &iov, 1, messages);
+}
+
+/**
+ * @brief Records the latency stages of a message that was just sent.
+ *
+ * @param stats (struct link_stats *) Stats of the link.
+ * @param changed_ns (uint64_t) When the state first changed, 0 for a repeated state.
+ * @param encode_ns (uint64_t) When the message was encoded.
+ * @param send_ns (uint64_t) When send() returned.
+ */
+void stats_sent(struct link_stats *stats, uint64_t changed_ns, uint64_t encode_ns, uint64_t send_ns) {
+    hist_add(&stats->stage[STAGE_SEND], (send_ns - encode_ns) / 1000);
+    if (stats->last_send_ns) {
+        hist_add(&stats->interval, (send_ns - stats->last_send_ns) / 1000);
+    }
+    stats->last_send_ns = send_ns;
+    if (changed_ns) {
+        hist_add(&stats->stage[STAGE_ENCODE], (encode_ns - changed_ns) / 1000);
+        hist_add(&stats->stage[STAGE_TOTAL], (send_ns - changed_ns) / 1000);
+    }
+}
+
+/**
+ * @brief Remembers when the state frame `seq` was sent, to time its ACK (see struct link_quality).
+ */
+void quality_sent(struct link *link, uint16_t seq) {
+    uint64_t now_us = stats_now_ns() / 1000;
+    atomic_store_explicit(&link->quality.sent[seq % QUALITY_RING], ((uint64_t)seq << 48) | (now_us & QUALITY_TIME_MASK),
+                          memory_order_relaxed);
+}
+
+/**
+ * @brief Takes the RTT sample of an ACK frame from the robot.
+ *
+ * The smoothing is TCP's: srtt moves by 1/8 of the error, rttvar by 1/4. A late ACK
+ * of a frame already counted as lost still gives its sample, so the loss timeout
+ * grows with the RTT; a duplicate ACK is ignored.
+ */
+void quality_ack(struct link *link, uint16_t seq) {
+    struct link_quality *quality = &link->quality;
+    int i = seq % QUALITY_RING;
+    uint64_t sent = atomic_load_explicit(&quality->sent[i], memory_order_relaxed);
+    if (sent == 0 || (uint16_t)(sent >> 48) != seq || quality->done[i] == (sent | QUALITY_ACKED)) {
+        return; // trame oubliée depuis, ou déjà acquittée
+    }
+    double rtt_us = (double)((stats_now_ns() / 1000 - sent) & QUALITY_TIME_MASK);
+    hist_add(&link->stats.rtt, (uint64_t)rtt_us);
+    if (!quality->has_rtt) {
+        quality->has_rtt = 1;
+        quality->srtt_us = rtt_us;
+        quality->rttvar_us = rtt_us / 2;
+        quality->min_rtt_us = rtt_us;
+        quality->window_min_us = rtt_us;
+        quality->window_at = SDL_GetTicks() + QUALITY_MIN_WINDOW_MS;
+    } else {
+        quality->rttvar_us += (fabs(quality->srtt_us - rtt_us) - quality->rttvar_us) / 4;
+        quality->srtt_us += (rtt_us - quality->srtt_us) / 8;
+    }
+    quality->min_rtt_us = fmin(quality->min_rtt_us, rtt_us);
+    quality->window_min_us = fmin(quality->window_min_us, rtt_us);
+    if (quality->done[i] != sent) {
+        link->stats.acks++;
+        quality->loss -= quality->loss / 32;
+    }
+    quality->done[i] = sent | QUALITY_ACKED;
+}
+
+/**
+ * @brief CPU time used by the process so far, in seconds, threads of the benchmark excluded.
+ */
+double stats_cpu_s(struct fleet *fleet) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+         + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6 - fleet->tool_cpu_ns / 1e9;
+}
+
+/**
+ * @brief Prints the latency histograms and counters of a link.
+ */
+void stats_print(struct link *link, FILE *out) {
+    struct link_stats *stats = &link->stats;
+    double elapsed = (stats_now_ns() - stats->start_ns) / 1e9;
+    if (elapsed <= 0) {
+        elapsed = 1e-9;
+    }
+    
+    fprintf(out, "--- Statistiques de %s sur %.1f s ---\n", link->name, elapsed);
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        hist_print(out, stage_names[i], &stats->stage[i]);
+    }
+    hist_print(out, "send_interval", &stats->interval);
+    fprintf(out, "  évènements %llu (%.0f/s), messages %llu (%.0f/s), octets %llu (%.0f/s)\n",
+            stats->events, stats->events / elapsed, stats->messages, stats->messages / elapsed,
+            stats->bytes, stats->bytes / elapsed);
+    fprintf(out, "  écritures %llu, dont %llu mises en file ; états remplacés avant envoi %llu, connexions perdues %llu\n",
+            stats->writes, stats->blocked, stats->superseded, stats->disconnects);
+    fprintf(out, "  télémétrie %llu trames (%.0f/s), octets reçus invalides %llu\n", stats->telemetry,
+            stats->telemetry / elapsed, stats->rx_invalid);
+    hist_print(out, "ack_rtt", &stats->rtt);
+    const struct link_quality *quality = &link->quality;
+    char rate[32] = "envoi direct";
+    if (link->rate_hz > 0) {
+        snprintf(rate, sizeof(rate), "%d Hz", atomic_load(&link->send_hz));
+    }
+    fprintf(out, "  liaison : rtt lissé %.1f ms (min %.1f, gigue %.1f), pertes %.1f%% (%llu acquittées, %llu perdues),"
+            " %s, sensibilité %.1f%%\n", quality->srtt_us / 1000, quality->min_rtt_us / 1000,
+            quality->rttvar_us / 1000, quality->loss * 100, stats->acks, stats->lost, rate, link->filter.delta * 100);
+    if (link->heartbeat_ms > 0) {
+        fprintf(out, "  battement : %llu trames, liaison perdue %llu fois\n", stats->heartbeats, stats->link_lost);
+    }
+    if (link->inject != NULL) {
+        fprintf(out, "  injection : %llu trames avec des entrées injectées\n", stats->injected);
+    }
+    if (link->motion_hz > 0) {
+        fprintf(out, "  mouvement %llu trames (%.0f/s), %llu échantillons, %llu octets (%.0f/s), %llu trames sautées\n",
+                stats->motion_frames, stats->motion_frames / elapsed, stats->motion_samples, stats->motion_bytes,
+                stats->motion_bytes / elapsed, stats->motion_dropped);
+    }
+}
+
+/**
+ * @brief Prints the stats of every link, then the CPU usage of the process.
+ */
+void fleet_stats_print(struct fleet *fleet, FILE *out) {
+    unsigned long long events = 0;
+    for (int i = 0; i < fleet->count; i++) {
+        stats_print(&fleet->links[i], out);
+        events += fleet->links[i].stats.events;
+    }
+    if (fleet->links[0].rate_hz > 0) {
+        hist_print(out, "tick_late", &fleet->tick_late);
+    }
+    double elapsed = (stats_now_ns() - fleet->links[0].stats.start_ns) / 1e9;
+    double cpu_s = stats_cpu_s(fleet);
+    fprintf(out, "  CPU %.2f s (%.1f%% d'un coeur), %.2f µs par évènement\n", cpu_s,
+            elapsed > 0 ? 100.0 * cpu_s / elapsed : 0.0, events ? cpu_s * 1e6 / events : 0.0);
+}
+
+/**
+ * @brief Writes the stats of every link as CSV (see STATS_CSV_HEADER) to compare runs.
+ *
+ * With several robots, the name of each row starts with the robot's name and "/".
+ *
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE if the file could not be written.
+ */
+int stats_csv(struct fleet *fleet, const char *path) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        return EXIT_FAILURE;
+    }
+    static const char *counter_names[] = {
+        "events", "messages", "bytes", "writes", "blocked_sends", "superseded", "disconnects", "telemetry_frames",
+        "rx_invalid_bytes", "motion_frames", "motion_samples", "motion_bytes", "motion_dropped",
+        "acks", "lost", "srtt_us", "rttvar_us", "min_rtt_us", "loss_permille", "send_hz", "delta_permille",
+        "injected", "heartbeats", "link_lost"
+    };
+    fputs(STATS_CSV_HEADER, out);
+    unsigned long long events = 0;
+    for (int l = 0; l < fleet->count; l++) {
+        struct link *link = &fleet->links[l];
+        struct link_stats *stats = &link->stats;
+        const char *prefix = fleet->count > 1 ? link->name : "";
+        const char *slash = fleet->count > 1 ? "/" : "";
+        char name[64];
+        for (int i = 0; i < STAGE_COUNT; i++) {
+            snprintf(name, sizeof(name), "%s%s%s", prefix, slash, stage_names[i]);
+            hist_csv(out, name, &stats->stage[i]);
+        }
+        snprintf(name, sizeof(name), "%s%sack_rtt", prefix, slash);
+        hist_csv(out, name, &stats->rtt);
+        snprintf(name, sizeof(name), "%s%ssend_interval", prefix, slash);
+        hist_csv(out, name, &stats->interval);
+        const struct link_quality *quality = &link->quality;
+        unsigned long long counters[] = {
+            stats->events, stats->messages, stats->bytes, stats->writes, stats->blocked, stats->superseded,
+            stats->disconnects, stats->telemetry, stats->rx_invalid, stats->motion_frames, stats->motion_samples,
+            stats->motion_bytes, stats->motion_dropped, stats->acks, stats->lost,
+            (unsigned long long)quality->srtt_us, (unsigned long long)quality->rttvar_us,
+            (unsigned long long)quality->min_rtt_us, (unsigned long long)(quality->loss * 1000),
+            (unsigned long long)atomic_load(&link->send_hz), (unsigned long long)(link->filter.delta * 1000),
+            stats->injected, stats->heartbeats, stats->link_lost
+        };
+        for (size_t i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+            snprintf(name, sizeof(name), "%s%s%s", prefix, slash, counter_names[i]);
+            counter_csv(out, name, counters[i]);
+        }
+        events += stats->events;
+    }
+    if (fleet->links[0].rate_hz > 0) {
+        hist_csv(out, "tick_late", &fleet->tick_late);
+    }
+    counter_csv(out, "elapsed_us", (stats_now_ns() - fleet->links[0].stats.start_ns) / 1000);
+    double cpu_s = stats_cpu_s(fleet);
+    counter_csv(out, "cpu_us", (unsigned long long)(cpu_s * 1e6));
+    counter_csv(out, "cpu_per_event_ns", events ? (unsigned long long)(cpu_s * 1e9 / events) : 0);
+    return fclose(out) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Marks the controller state of a link as changed.
+ *
+ * Nothing is sent here: link_flush() publishes the state once at the end of the loop
+ * cycle, however many events changed it.
+ *
+ * @param link (struct link *) The link whose state changed.
+ *
+ * @return Returns EXIT_SUCCESS.
+ */
+int publish_state(struct link *link) {
+    if (!link->dirty) {
+        link->changed_ns = stats_now_ns();
+        link->dirty = 1;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Records a button edge before the new state is published.
+ *
+ * A snapshot protocol loses a button pressed and released between two frames, and
+ * over UDP it loses an edge whose frame is dropped. Small schemes avoid that:
+ * - paced mode: a button released before its press was published stays reported as
+ *   pressed (a "tap") for BTN_REPEAT frames;
+ * - direct TCP mode: a button pressed and released in the same loop cycle is sent as
+ *   two frames, pressed then released, in the same write;
+ * - direct UDP mode: the state is sent again BTN_REPEAT - 1 times, BTN_REPEAT_MS apart,
+ *   and a release that comes before the press was repeated waits for those repeats.
+ *
+ * @param link (struct link *) The link whose button changed.
+ * @param button (int) The button index.
+ * @param pressed (int) 1 for a press, 0 for a release.
+ */
+void button_edge(struct link *link, int button, int pressed) {
+    if (link->rate_hz > 0) {
+        unsigned next_version = atomic_load_explicit(&link->shared.seq, memory_order_relaxed) + 2;
+        if (pressed) {
+            link->press_version[button] = next_version;
+        } else if ((int)(atomic_load(&link->published) - link->press_version[button]) < 0) {
+            link->taps |= (uint16_t)(1u << button);
+            link->taps_version = next_version;
+        }
+    } else if (!link->udp) {
+        uint16_t bit = (uint16_t)(1u << button);
+        if (pressed) {
+            link->cycle_press |= bit;
+        } else if (link->cycle_press & bit) {
+            link->taps |= bit;
+        }
+    } else {
+        uint16_t bit = (uint16_t)(1u << button);
+        if (pressed) {
+            link->repeat_press |= bit;
+        } else if (link->repeat_left > 0 && (link->repeat_press & bit)) {
+            link->taps |= bit;
+        }
+        link->repeat_left = BTN_REPEAT - 1;
+        link->repeat_at = SDL_GetTicks() + BTN_REPEAT_MS;
+    }
+}
+
+/**
+ * @brief Milliseconds until the SDL_GetTicks() deadline `at`, 0 if it is past.
+ */
+int ticks_until(Uint32 at) {
+    int delay = (int)(at - SDL_GetTicks());
+    return delay > 0 ? delay : 0;
+}
+
+/**
+ * @brief Time the main loop may sleep before a timer of the link is due.
+ *
+ * The timers are the UDP repeats, the age of the motion batch, the link quality
+ * estimation with -A, the injection slots while a process holds one (-i), the
+ * heartbeat and the silence of the robot (-H), the next connection attempt and, in
+ * direct mode, the stall deadline of a queue that does not drain.
+ *
+ * @return The timeout in milliseconds for SDL_WaitEventTimeout, or -1 for none.
+ */
+int link_timeout_ms(struct link *link) {
+    int timeout = -1;
+    if (link->repeat_left > 0) {
+        timeout = ticks_until(link->repeat_at);
+    }
+    if (link->motion.count > 0 || link->motion_touched) {
+        int delay = ticks_until(link->motion_since + MOTION_MAX_AGE_MS);
+        if (timeout < 0 || delay < timeout) {
+            timeout = delay;
+        }
+    }
+    if (link->quality.adaptive && atomic_load(&link->status) == LINK_UP) {
+        int delay = ticks_until(link->quality.next_at);
+        if (timeout < 0 || delay < timeout) {
+            timeout = delay;
+        }
+    }
+    if (link->inject != NULL && inject_claimed(link->inject, link->inject_robot)) {
+        int delay = link->rate_hz > 0 ? ticks_until(link->inject_at) : INJECT_POLL_MS;
+        if (timeout < 0 || delay < timeout) {
+            timeout = delay;
+        }
+    }
+    if (link->heartbeat_ms > 0) {
+        int delays[3] = { -1, -1, -1 };
+        if (!link->dead) {
+            delays[0] = ticks_until(link->heard_at + HEARTBEAT_DEAD * link->heartbeat_ms);
+        }
+        if (link->rate_hz == 0 && atomic_load(&link->status) == LINK_UP && link->queue.len == 0) {
+            delays[1] = ticks_until(link->sent_at + link->heartbeat_ms);
+            delays[2] = ticks_until(link->refresh_at + link->refresh_ms);
+        }
+        for (int i = 0; i < 3; i++) {
+            if (delays[i] >= 0 && (timeout < 0 || delays[i] < timeout)) {
+                timeout = delays[i];
+            }
+        }
+    }
+    int delay = -1;
+    if (atomic_load(&link->status) == LINK_DOWN) {
+        delay = ticks_until(link->reconnect_at);
+    } else if (link->rate_hz == 0 && link->queue.len > 0) {
+        delay = ticks_until(link->queue.since + LINK_STALL_MS);
+    }
+    if (delay >= 0 && (timeout < 0 || delay < timeout)) {
+        timeout = delay;
+    }
+    return timeout;
+}
+
+/**
+ * @brief Runs the timers of the link that are due.
+ */
+void link_timers(struct link *link) {
+    if (link->repeat_left > 0 && (int)(SDL_GetTicks() - link->repeat_at) >= 0) {
+        link->repeat_left--;
+        link->repeat_at += BTN_REPEAT_MS;
+        if (link->repeat_left == 0) {
+            link->repeat_press = 0;
+            if (link->taps) {
+                // Les appuis brefs ont été répétés : au tour de leur relâchement
+                link->taps = 0;
+                link->repeat_left = BTN_REPEAT - 1;
+            }
+        }
+        publish_state(link);
+    }
+}
+
+/**
+ * @brief The state to send: the controller merged with the injected states (-i).
+ *
+ * While the takeover button is held the controller alone counts. With injection on,
+ * that button is kept on the PC and never reaches the robot.
+ *
+ * @param link (struct link *) The link.
+ * @param manual (const struct controller_state *) The controller state.
+ * @param out (struct controller_state *) The state to send, may be `manual`.
+ *
+ * @return A bit per injection slot whose state was used, 0 if the controller alone counts.
+ */
+unsigned link_merged_state(struct link *link, const struct controller_state *manual, struct controller_state *out) {
+    if (link->inject == NULL) {
+        *out = *manual;
+        return 0;
+    }
+    uint16_t takeover_bit = (uint16_t)(1u << link->takeover_button);
+    unsigned used = inject_merge(link->inject, link->inject_robot, manual, (manual->buttons & takeover_bit) != 0,
+                                 stats_now_ns(), out);
+    out->buttons &= (uint16_t)~takeover_bit;
+    return used;
+}
+
+/**
+ * @brief Follows the injection slots of the link (-i).
+ *
+ * In direct mode nothing else notices a process writing into its slot, so the merged
+ * state is recomputed at every loop cycle, every INJECT_POLL_MS at least while a slot
+ * is held, and a change is published like a controller event. In paced mode the
+ * sender thread merges at every tick by itself. Every INJECT_STATUS_MS, the processes
+ * that start or stop commanding the robot and the manual takeover are reported.
+ */
+void link_inject(struct link *link) {
+    if (link->inject == NULL) {
+        return;
+    }
+    Uint32 now = SDL_GetTicks();
+    if (link->rate_hz == 0 && !link->texte) {
+        struct controller_state merged;
+        link_merged_state(link, &link->state, &merged);
+        if (memcmp(&merged, &link->inject_last, sizeof(merged)) != 0) {
+            if (link->udp && merged.buttons != link->inject_last.buttons) {
+                // Un bouton injecté est répété comme un bouton de la manette
+                link->repeat_left = BTN_REPEAT - 1;
+                link->repeat_at = now + BTN_REPEAT_MS;
+            }
+            link->inject_last = merged;
+            publish_state(link);
+        }
+    }
+    if ((int)(now - link->inject_at) < 0) {
+        return;
+    }
+    link->inject_at = now + INJECT_STATUS_MS;
+    
+    int takeover = (link->state.buttons >> link->takeover_button) & 1;
+    if (takeover != link->inject_takeover) {
+        link->inject_takeover = takeover;
+        printf(takeover ? "Reprise manuelle de %s\n" : "Fin de la reprise manuelle de %s\n", link->name);
+    }
+    uint64_t now_ns = stats_now_ns();
+    for (int i = 0; i < INJECT_SLOTS; i++) {
+        struct inject_slot *slot = &link->inject->slots[link->inject_robot][i];
+        struct inject_view view;
+        inject_read(slot, now_ns, &view);
+        unsigned bit = 1u << i;
+        unsigned active = view.fresh && (view.buttons_mask || view.axes_mask) ? bit : 0;
+        if (active == (link->inject_active & bit)) {
+            continue;
+        }
+        link->inject_active ^= bit;
+        char name[sizeof(slot->name)];
+        memcpy(name, slot->name, sizeof(name)); // écrit par l'autre processus : toujours terminer la copie
+        name[sizeof(name) - 1] = '\0';
+        if (active) {
+            printf("Injection : %s commande %s (priorité %d)\n", name, link->name, view.priority);
+        } else {
+            printf("Injection : %s ne commande plus %s\n", name, link->name);
+        }
+    }
+}
+
+/**
+ * @brief Sends everything the current loop cycle produced for the link, in one write.
+ *
+ * - binary direct mode: one frame with the latest state (two for a tap over TCP);
+ * - paced mode: one write of the shared state, the sender thread does the sending;
+ * - text mode: the queued button messages and one line per changed axis, in one writev.
+ *
+ * When the socket still has a queue, only button edges are written behind it: a state
+ * or an axis line that only moves the sticks is skipped, and the latest one is sent
+ * once the queue drains. While the robot is not connected nothing is sent at all,
+ * the connection resynchronizes the whole state (see link_resync()).
+ *
+ * @param link (struct link *) The link to flush.
+ *
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE if the write failed.
+ */
+int link_flush(struct link *link) {
+    if (!link->dirty) {
+        return EXIT_SUCCESS;
+    }
+    link->dirty = 0;
+    
+    if (link->rate_hz == 0 && atomic_load(&link->status) != LINK_UP) {
+        link->batch.text_len = 0;
+        link->batch.axis_dirty = 0;
+        link->taps = 0;
+        link->cycle_press = 0;
+        return EXIT_SUCCESS;
+    }
+    
+    if (link->texte) {
+        struct out_batch *batch = &link->batch;
+        char axes[FRAME_AXIS_COUNT * CONTROLS_TEXT_MAX];
+        size_t axes_len = 0;
+        int messages = 0;
+        for (size_t i = 0; i < batch->text_len; i++) {
+            messages += batch->text[i] == '\n';
+        }
+        if (link->queue.len > 0 && batch->axis_dirty) {
+            // La socket ne suit plus : les axes attendent, seule leur dernière valeur partira
+            link->stale = 1;
+            link->stats.superseded++;
+        } else {
+            for (int i = 0; i < FRAME_AXIS_COUNT; i++) {
+                if (batch->axis_dirty & (1u << i)) {
+                    axes_len += controls_format_axis(i, batch->axis[i], axes + axes_len);
+                    messages++;
+                }
+            }
+            batch->axis_dirty = 0;
+        }
+        printf("%.*s%.*s", (int)batch->text_len, batch->text, (int)axes_len, axes);
+        struct iovec iov[2] = { { batch->text, batch->text_len }, { axes, axes_len } };
+        batch->text_len = 0;
+        uint64_t encode_ns = stats_now_ns();
+        int result = link_writev(link, iov, 2, messages);
+        stats_sent(&link->stats, link->changed_ns, encode_ns, stats_now_ns());
+        return result;
+    }
+    
+    if (link->rate_hz > 0) {
+        // Les appuis brefs déjà publiés n'ont plus besoin d'être retenus
+        if (link->taps && (int)(atomic_load(&link->published) - link->taps_version) >= 0) {
+            link->taps = 0;
+        }
+        shared_state_write(&link->shared, &link->state, link->taps, link->changed_ns);
+        return EXIT_SUCCESS;
+    }
+    
+    struct controller_state merged;
+    unsigned injected = link_merged_state(link, &link->state, &merged);
+    link->inject_last = merged;
+    if (link->queue.len > 0 && !link->taps && merged.buttons == link->queued_buttons) {
+        // La socket ne suit plus : cet état sera remplacé par un plus récent
+        link->stale = 1;
+        link->stats.superseded++;
+        link->cycle_press = 0;
+        return EXIT_SUCCESS;
+    }
+    uint8_t frames[2 * FRAME_MAX_SIZE];
+    int count = 1;
+    struct controller_state state = link->state;
+    state.buttons |= link->taps;
+    if (link->taps) {
+        injected |= link_merged_state(link, &state, &state);
+    } else {
+        state = merged;
+    }
+    size_t len = 0;
+    int heartbeats = 0;
+    if (link->heartbeat_ms > 0 && atomic_exchange(&link->resend, 0)) {
+        // Arme tout de suite le chien de garde du robot (voir link_resync())
+        quality_sent(link, link->seq);
+        len = frame_encode_heartbeat(frames, link->seq++);
+        link->stats.heartbeats++;
+        heartbeats = 1;
+    }
+    uint16_t first_seq = link->seq;
+    len += frame_encode_state(frames + len, link->seq++, &state);
+    if (!link->udp && link->taps) {
+        // TCP : l'appui bref et son relâchement partent dans la même écriture
+        link->taps = 0;
+        len += frame_encode_state(frames + len, link->seq++, &merged);
+        count++;
+    }
+    link->cycle_press = 0;
+    link->queued_buttons = merged.buttons;
+    link->sent_at = link->refresh_at = SDL_GetTicks();
+    if (injected) {
+        link->stats.injected += count;
+    }
+    uint64_t encode_ns = stats_now_ns();
+    int result = link_write(link, frames, len, count + heartbeats);
+    stats_sent(&link->stats, link->changed_ns, encode_ns, stats_now_ns());
+    for (int i = 0; i < count; i++) {
+        quality_sent(link, (uint16_t)(first_seq + i));
+    }
+    return result;
+}
+
+/**
+ * @brief Queues a text-protocol message of `len` bytes for the end of the loop cycle.
+ */
+void batch_text(struct link *link, const char *message, size_t len) {
+    struct out_batch *batch = &link->batch;
+    if (batch->text_len + len > sizeof(batch->text)) {
+        link_flush(link);
+    }
+    memcpy(batch->text + batch->text_len, message, len);
+    batch->text_len += len;
+    publish_state(link);
+}
+
+/**
+ * @brief Sends the latest state of one link from the sender thread.
+ *
+ * Every tick carries the whole state, so when the socket still holds a queue the tick
+ * is simply skipped: the next one sends a newer state. The shared state keeps its
+ * taps until a frame carrying them was actually written. With -A a congested link
+ * sends at send_hz only, one tick out of several, except for a button change which
+ * still goes at the next tick. With -i the injected states are merged at every tick.
+ *
+ * With -H an unchanged state stops going out once it was sent BTN_REPEAT times, for
+ * UDP losses: a heartbeat frame goes instead every heartbeat_ms, and the full state
+ * again every refresh_ms. A tick skipped by -A is never skipped past a heartbeat.
+ * After a connection, the first state frame follows a heartbeat (see link_resync()).
+ */
+void sender_tick(struct link *link) {
+    pthread_mutex_lock(&link->io_lock);
+    if (atomic_load(&link->status) != LINK_UP) {
+        pthread_mutex_unlock(&link->io_lock);
+        return;
+    }
+    link_drain(link);
+    if (link->queue.len > 0) {
+        link->stats.superseded++;
+        if (link_stalled(link)) {
+            link_fail(link);
+        }
+        pthread_mutex_unlock(&link->io_lock);
+        return;
+    }
+    
+    struct controller_state state;
+    uint16_t taps;
+    uint64_t changed_ns;
+    unsigned version = shared_state_read(&link->shared, &state, &taps, &changed_ns);
+    int tap_frames = version != link->sent_version ? 0 : link->tap_frames;
+    if (taps && tap_frames < BTN_REPEAT) {
+        state.buttons |= taps;
+    }
+    unsigned injected = link_merged_state(link, &state, &state);
+    int heartbeat = 0;
+    int arm = link->heartbeat_ms > 0 && atomic_exchange(&link->resend, 0);
+    if (link->heartbeat_ms > 0) {
+        // -H : un état déjà parti BTN_REPEAT fois ne repart qu'au rafraîchissement, un battement suffit
+        uint64_t now_ns = stats_now_ns();
+        if (memcmp(&state, &link->sent_state, sizeof(state)) != 0 || arm) {
+            link->same_frames = 0;
+        }
+        if (link->same_frames >= BTN_REPEAT && now_ns - link->refresh_ns < link->refresh_ms * 1000000ull) {
+            if (now_ns - link->stats.last_send_ns < link->heartbeat_ms * 1000000ull) {
+                link->sent_version = version;
+                pthread_mutex_unlock(&link->io_lock);
+                atomic_store(&link->published, version);
+                return;
+            }
+            heartbeat = 1;
+        }
+    }
+    int hz = atomic_load(&link->send_hz);
+    if (hz < link->rate_hz && !heartbeat) {
+        uint64_t now_ns = stats_now_ns();
+        uint64_t interval_ns = 1000000000ull / hz;
+        if (state.buttons == link->sent_buttons && (int64_t)(now_ns + 500000000ull / link->rate_hz - link->send_at_ns) < 0
+            && !arm && (link->heartbeat_ms == 0 || now_ns - link->stats.last_send_ns < link->heartbeat_ms * 1000000ull)) {
+            pthread_mutex_unlock(&link->io_lock);
+            return;
+        }
+        // Échéances régulières, sauf après un trou : pas de rafale pour rattraper
+        link->send_at_ns = (int64_t)(now_ns - link->send_at_ns) > (int64_t)interval_ns ? now_ns + interval_ns
+                         : link->send_at_ns + interval_ns;
+    }
+    if (version != link->sent_version) {
+        link->sent_version = version;
+        link->tap_frames = 0;
+    } else {
+        changed_ns = 0; // simple répétition, pas un nouveau changement
+    }
+    if (taps && link->tap_frames < BTN_REPEAT) {
+        link->tap_frames++;
+    }
+    uint8_t frame[FRAME_MAX_SIZE];
+    size_t len = 0;
+    int count = 1;
+    if (arm) {
+        // Arme tout de suite le chien de garde du robot, même si le pilote ne lâche pas les manches
+        quality_sent(link, link->seq);
+        len = frame_encode_heartbeat(frame, link->seq++);
+        link->stats.heartbeats++;
+        count++;
+    }
+    uint16_t seq = link->seq++;
+    if (heartbeat) {
+        len += frame_encode_heartbeat(frame + len, seq);
+        link->stats.heartbeats++;
+        changed_ns = 0;
+    } else {
+        len += frame_encode_state(frame + len, seq, &state);
+        link->sent_state = state;
+        link->same_frames++;
+        link->refresh_ns = stats_now_ns();
+        if (injected) {
+            link->stats.injected++;
+        }
+    }
+    uint64_t encode_ns = stats_now_ns();
+    link_write(link, frame, len, count);
+    stats_sent(&link->stats, changed_ns, encode_ns, stats_now_ns());
+    quality_sent(link, seq);
+    link->sent_buttons = state.buttons;
+    pthread_mutex_unlock(&link->io_lock);
+    atomic_store(&link->published, version);
+}
+
+/**
+ * @brief Sender thread of the paced mode: sends the latest state of every robot every 1/rate_hz second.
+ *
+ * Ticks are scheduled on absolute CLOCK_MONOTONIC deadlines so the cadence does not
+ * drift. If a send overruns several periods, the missed ticks are skipped instead of
+ * being sent in a burst. The worst-case delay between an input and its frame is
+ * therefore one period plus one send per robot.
+ *
+ * @param arg (void *) The struct fleet to serve.
+ */
+void *sender_thread(void *arg) {
+    struct fleet *fleet = arg;
+    long period_ns = 1000000000L / fleet->links[0].rate_hz;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    
+    while (atomic_load(&fleet->sender_running)) {
+        next.tv_nsec += period_ns;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        struct timespec woken;
+        clock_gettime(CLOCK_MONOTONIC, &woken);
+        long late_ns = (woken.tv_sec - next.tv_sec) * 1000000000L + (woken.tv_nsec - next.tv_nsec);
+        hist_add(&fleet->tick_late, late_ns > 0 ? (uint64_t)late_ns / 1000 : 0);
+        
+        for (int i = 0; i < fleet->count; i++) {
+            sender_tick(&fleet->links[i]);
+        }
+        
+        // En retard de plus d'une période : on repart de maintenant
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if ((now.tv_sec - next.tv_sec) * 1000000000L + (now.tv_nsec - next.tv_nsec) > period_ns) {
+            next = now;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Turns socket readability into SDL events so the main loop can sleep in SDL_WaitEventTimeout.
+ *
+ * SDL cannot wait on file descriptors, so a small thread blocks in epoll_wait on them
+ * and pushes one `event_type` SDL event per ready descriptor (`user.code` = fd,
+ * `user.data1` = the epoll event mask). A descriptor can also be watched for
+ * writability, for a connection in progress or a send queue to empty.
+ * Descriptors are registered with EPOLLONESHOT: after handling the event, the main
+ * loop calls watcher_rearm() once it has drained the descriptor.
+ */
+struct watcher {
+    int epfd;
+    int stopfd;             // eventfd pour réveiller et arrêter le thread
+    Uint32 event_type;      // évènement SDL poussé quand un descripteur est lisible
+    pthread_t thread;
+};
+
+void *watcher_thread(void *arg) {
+    struct watcher *watcher = arg;
+    struct epoll_event events[8];
+    
+    for (;;) {
+        int n = epoll_wait(watcher->epfd, events, 8, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return NULL;
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == watcher->stopfd) {
+                return NULL;
+            }
+            SDL_Event event;
+            memset(&event, 0, sizeof(event));
+            event.type = watcher->event_type;
+            event.user.code = events[i].data.fd;
+            event.user.data1 = (void *)(uintptr_t)events[i].events;
+            SDL_PushEvent(&event);
+        }
+    }
+}
+
+/**
+ * @brief Creates the watcher and starts its thread.
+ *
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE if a resource could not be created.
+ */
+int watcher_start(struct watcher *watcher) {
+    watcher->event_type = SDL_RegisterEvents(1);
+    if (watcher->event_type == (Uint32)-1) {
+        return EXIT_FAILURE;
+    }
+    watcher->epfd = epoll_create1(EPOLL_CLOEXEC);
+    watcher->stopfd = eventfd(0, EFD_CLOEXEC);
+    if (watcher->epfd < 0 || watcher->stopfd < 0) {
+        return EXIT_FAILURE;
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = watcher->stopfd };
+    epoll_ctl(watcher->epfd, EPOLL_CTL_ADD, watcher->stopfd, &ev);
+    if (pthread_create(&watcher->thread, NULL, watcher_thread, watcher) != 0) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Starts watching a descriptor, also for writability if `out` is 1.
+ */
+int watcher_add(struct watcher *watcher, int fd, int out) {
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT | (out ? EPOLLOUT : 0), .data.fd = fd };
+    return epoll_ctl(watcher->epfd, EPOLL_CTL_ADD, fd, &ev) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int watcher_rearm(struct watcher *watcher, int fd, int out) {
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT | (out ? EPOLLOUT : 0), .data.fd = fd };
+    return epoll_ctl(watcher->epfd, EPOLL_CTL_MOD, fd, &ev) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void watcher_stop(struct watcher *watcher) {
+    uint64_t one = 1;
+    if (write(watcher->stopfd, &one, sizeof(one)) == sizeof(one)) {
+        pthread_join(watcher->thread, NULL);
+    }
+    close(watcher->stopfd);
+    close(watcher->epfd);
+}
+
+/**
+ * @brief Decodes the frames at the start of `buf` and keeps the latest telemetry.
+ *
+ * ACK frames time the link (see struct link_quality). Bytes that do not start a valid frame are skipped
+ * one at a time to resynchronise on the next FRAME_MAGIC, like the ESP32 does.
+ *
+ * @return The number of bytes consumed; the rest is the start of an incomplete frame.
+ */
+size_t receive_frames(struct link *link, const uint8_t *buf, size_t len) {
+    size_t pos = 0;
+    while (pos < len) {
+        struct frame frame;
+        int n = frame_decode(buf + pos, len - pos, &frame);
+        if (n == 0) {
+            break;
+        }
+        if (n < 0) {
+            link->stats.rx_invalid++;
+            pos++;
+            continue;
+        }
+        if (frame.type == FRAME_TYPE_ACK) {
+            // Seul un acquittement prouve que le robot entend le PC : la télémétrie part sans
+            link->heard_at = SDL_GetTicks();
+        }
+        if (frame.type == FRAME_TYPE_TELEMETRY && frame_rx_accept(&link->telemetry_rx, frame.seq)) {
+            link->telemetry = frame.telemetry;
+            link->has_telemetry = 1;
+            link->stats.telemetry++;
+        } else if (frame.type == FRAME_TYPE_ACK) {
+            quality_ack(link, frame.seq);
+        }
+        pos += n;
+    }
+    return pos;
+}
+
+/**
+ * @brief Reads and decodes whatever the ESP32 sent on the link socket, without waiting.
+ *
+ * The binary robot sends ACK and telemetry frames (see frame.h); the text robot only
+ * replies to be polite and its bytes are dropped. Reading also notices that the TCP
+ * connection was closed, by the robot or by link_fail(). Over UDP each datagram is
+ * parsed on its own, there is no connection to lose, and an ICMP error (robot not
+ * listening yet) is not fatal.
+ *
+ * @param link (struct link *) The link whose socket became readable.
+ *
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE if the connection is lost.
+ */
+int receive(struct link *link) {
+    struct rx_buffer *rx = &link->rx;
+    for (;;) {
+        ssize_t n = recv(link->sock, rx->data + rx->len, sizeof(rx->data) - rx->len, MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (link->udp || errno == EAGAIN || errno == EWOULDBLOCK) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        if (n == 0 && !link->udp) {
+            return EXIT_FAILURE;
+        }
+        rx->len += (size_t)n;
+        size_t used = link->texte ? rx->len : receive_frames(link, rx->data, rx->len);
+        if (link->udp) {
+            used = rx->len; // la fin d'un datagramme ne sera jamais complétée
+        }
+        memmove(rx->data, rx->data + used, rx->len - used);
+        rx->len -= used;
+    }
+}
+
+void axis_filter_init(struct axis_filter *filter) {
+    memset(filter, 0, sizeof(*filter));
+    filter->stick = (struct axis_config){ 0.08f, 0.02f, 1.0f };
+    filter->trigger = (struct axis_config){ 0.03f, 0.01f, 1.0f };
+    filter->delta = 0.01f;
+    for (int i = 0; i < 4; i++) {
+        filter->resting[i] = 1;
+    }
+}
+
+/**
+ * @brief Applies deadzone, hysteresis and response curve to a magnitude in [0, 1].
+ */
+float axis_shape(const struct axis_config *config, float magnitude, int *resting) {
+    float threshold = config->deadzone + (*resting ? config->hysteresis : 0.0f);
+    if (magnitude <= threshold) {
+        *resting = 1;
+        return 0.0f;
+    }
+    *resting = 0;
+    float t = (magnitude - config->deadzone) / (1.0f - config->deadzone);
+    if (t > 1.0f) {
+        t = 1.0f;
+    }
+    return config->expo == 1.0f ? t : powf(t, config->expo);
+}
+
+/**
+ * @brief Tells whether a shaped axis value differs enough from the last sent one.
+ */
+int axis_worth_sending(const struct axis_filter *filter, int16_t out, int16_t sent) {
+    if (out == sent) {
+        return 0;
+    }
+    if (out == 0 || out == AXIS_MAX || out == -AXIS_MAX) {
+        return 1;
+    }
+    return abs(out - sent) >= filter->delta * AXIS_MAX;
+}
+
+/**
+ * @brief Feeds a new raw axis value and computes what must be sent.
+ *
+ * A stick axis is shaped together with the other axis of the same stick, so moving
+ * X can also change the shaped Y (radial deadzone and curve).
+ *
+ * @param filter (struct axis_filter *) Filter state of the controller.
+ * @param axis (int) The SDL axis that moved.
+ * @param raw (int16_t) Its new raw value.
+ * @param out (int16_t *) Receives the shaped values, FRAME_AXIS_COUNT entries.
+ *
+ * @return A bitmask of the axes to send (bit n = axis n), 0 if nothing changed enough.
+ *         Those axes are recorded as sent.
+ */
+unsigned axis_filter_update(struct axis_filter *filter, int axis, int16_t raw, int16_t *out) {
+    filter->raw[axis] = raw;
+    unsigned candidates;
+    
+    if (axis <= FRAME_AXIS_JDY) { // Joysticks : zone morte radiale
+        int x_axis = axis & ~1;
+        int group = x_axis / 2;
+        float x = filter->raw[x_axis] / (float)AXIS_MAX;
+        float y = filter->raw[x_axis + 1] / (float)AXIS_MAX;
+        float magnitude = sqrtf(x * x + y * y);
+        float shaped = axis_shape(&filter->stick, magnitude > 1.0f ? 1.0f : magnitude, &filter->resting[group]);
+        float scale = magnitude > 0.0f ? shaped / magnitude : 0.0f;
+        out[x_axis] = (int16_t)lrintf(fmaxf(-1.0f, fminf(1.0f, x * scale)) * AXIS_MAX);
+        out[x_axis + 1] = (int16_t)lrintf(fmaxf(-1.0f, fminf(1.0f, y * scale)) * AXIS_MAX);
+        candidates = 3u << x_axis;
+    } else { // Gâchettes : zone morte linéaire
+        float value = raw > 0 ? raw / (float)AXIS_MAX : 0.0f;
+        out[axis] = (int16_t)lrintf(axis_shape(&filter->trigger, value, &filter->resting[axis - 2]) * AXIS_MAX);
+        candidates = 1u << axis;
+    }
+    
+    unsigned changed = 0;
+    for (int i = 0; i < FRAME_AXIS_COUNT; i++) {
+        if ((candidates & (1u << i)) && axis_worth_sending(filter, out[i], filter->sent[i])) {
+            filter->sent[i] = out[i];
+            changed |= 1u << i;
+        }
+    }
+    return changed;
+}
+
+/**
+ * @brief Handles button press events from an SDL controller and sends corresponding data to an ESP device.
+ * 
+ * In binary mode (the default) the button bit is set in the link state and the whole
+ * state is sent as one frame. In text mode the message of the button, name + "P\n"
+ * (e.g. "CroixP\n"), is taken from the tables generated from controls.h.
+ * 
+ * @param event (type: SDL_Event) The SDL event containing information about the button press.
+ * @param link (struct link *) The link used for sending the data.
+ * 
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE if the button is not part of the protocol.
+ */
+int press_button(SDL_Event event, struct link *link) {
+    int button = event.cbutton.button;
+    if (button >= FRAME_BTN_COUNT) {
+        return EXIT_FAILURE;
+    }
+    link->state.buttons |= (uint16_t)(1u << button);
+    if (link->texte) {
+        batch_text(link, control_press_text[button].text, control_press_text[button].len);
+        return EXIT_SUCCESS;
+    }
+    button_edge(link, button, 1);
+    return publish_state(link);
+}
+
+/**
+ * @brief Handles joystick events and processes input from the controller's axes.
+ * 
+ * This function feeds the new axis value to the link's axis filter (deadzone, curve,
+ * delta suppression) and sends the axes that changed enough.
+ * 
+ * @param event (type: SDL_Event) The SDL event containing joystick axis data.
+ * @param link (struct link *) The link used for sending the data.
+ * 
+ * The function handles the following axes:
+ * - SDL_CONTROLLER_AXIS_LEFTX: Left joystick horizontal axis ("JGX").
+ * - SDL_CONTROLLER_AXIS_LEFTY: Left joystick vertical axis ("JGY").
+ * - SDL_CONTROLLER_AXIS_RIGHTX: Right joystick horizontal axis ("JDX").
+ * - SDL_CONTROLLER_AXIS_RIGHTY: Right joystick vertical axis ("JDY").
+ * - SDL_CONTROLLER_AXIS_TRIGGERLEFT: Left trigger axis ("GG").
+ * - SDL_CONTROLLER_AXIS_TRIGGERRIGHT: Right trigger axis ("GD").
+ * 
+ * The shaped values are stored in the link state. In binary mode (the default) the
+ * whole state is sent as one frame. In text mode each changed axis is sent as a
+ * "NAME:value" line under the name above. Either way, the sending happens once per
+ * loop cycle in link_flush().
+ * 
+ * @return Returns EXIT_SUCCESS if an axis changed, otherwise EXIT_FAILURE.
+ */
+int joystick(SDL_Event event, struct link *link) {
+    if (event.caxis.axis >= FRAME_AXIS_COUNT) {
+        return EXIT_FAILURE;
+    }
+    int16_t out[FRAME_AXIS_COUNT];
+    unsigned changed = axis_filter_update(&link->filter, event.caxis.axis, event.caxis.value, out);
+    if (!changed) {
+        return EXIT_FAILURE;
+    }
+    
+    for (int i = 0; i < FRAME_AXIS_COUNT; i++) {
+        if (!(changed & (1u << i))) {
+            continue;
+        }
+        link->state.axes[i] = out[i];
+        if (link->texte) {
+            link->batch.axis[i] = out[i];
+            link->batch.axis_dirty |= 1u << i;
+        }
+    }
+    return publish_state(link);
+}
+
+/**
+ * @brief Handles the release of buttons on an SDL controller and sends corresponding data to an ESP device.
+ *
+ * In binary mode (the default) the button bit is cleared in the link state and the
+ * whole state is sent as one frame. In text mode the message of the button, name +
+ * "R\n" (e.g. "CroixR\n"), is taken from the tables generated from controls.h.
+ *
+ * @param event (type: SDL_Event) The SDL event containing information about the button release.
+ * @param link (struct link *) The link used for sending the data.
+ *
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE if the button is not part of the protocol.
+ */
+int release_button(SDL_Event event, struct link *link) {
+    int button = event.cbutton.button;
+    if (button >= FRAME_BTN_COUNT) {
+        return EXIT_FAILURE;
+    }
+    link->state.buttons &= (uint16_t)~(1u << button);
+    if (link->texte) {
+        batch_text(link, control_release_text[button].text, control_release_text[button].len);
+        return EXIT_SUCCESS;
+    }
+    button_edge(link, button, 0);
+    return publish_state(link);
+}
+
+/**
+ * @brief Quantizes a sensor reading to the int16 of a motion frame.
+ */
+int16_t motion_quantize(float value, float scale) {
+    float scaled = roundf(value * scale);
+    return (int16_t)(scaled > 32767 ? 32767 : scaled < -32768 ? -32768 : scaled);
+}
+
+/**
+ * @brief Encodes the motion batch of the link for the end of the loop cycle and starts a new one.
+ *
+ * At most MOTION_OUT_FRAMES frames wait for link_send_motion(); a batch beyond that is
+ * dropped.
+ */
+void motion_close_batch(struct link *link) {
+    struct motion *motion = &link->motion;
+    if (link->motion_out_frames < MOTION_OUT_FRAMES) {
+        link->motion_out_len += frame_encode_motion(link->motion_out + link->motion_out_len, link->motion_seq++,
+                                                    motion);
+        link->motion_out_frames++;
+        link->motion_out_samples += motion->count;
+    } else {
+        link->stats.motion_dropped++;
+    }
+    motion->count = 0;
+    link->motion_touched = 0;
+}
+
+/**
+ * @brief Adds the last averaged sample of the motion filter to the batch of the link.
+ *
+ * The batch is closed when it is full, and before a sample whose offset would not fit
+ * in 16 bits.
+ *
+ * @param link (struct link *) The link.
+ * @param time_us (uint64_t) Controller timestamp of the sample.
+ */
+void motion_add_sample(struct link *link, uint64_t time_us) {
+    struct motion *motion = &link->motion;
+    if (motion->count > 0 && time_us - link->motion_base_us > UINT16_MAX) {
+        motion_close_batch(link);
+    }
+    if (motion->count == 0) {
+        if (!link->motion_touched) {
+            link->motion_since = SDL_GetTicks();
+        }
+        link->motion_base_us = time_us;
+        motion->time_us = (uint32_t)time_us;
+    }
+    struct motion_sample *sample = &motion->samples[motion->count++];
+    sample->offset_us = (uint16_t)(time_us - link->motion_base_us);
+    memcpy(sample->gyro, link->motion_filter.last[0], sizeof(sample->gyro));
+    memcpy(sample->accel, link->motion_filter.last[1], sizeof(sample->accel));
+    if (motion->count == FRAME_MOTION_MAX) {
+        motion_close_batch(link);
+    }
+}
+
+/**
+ * @brief Handles a gyroscope or accelerometer reading of the controller of a link.
+ *
+ * Readings are timed by the controller when SDL provides it, otherwise on arrival.
+ */
+void motion_sensor(struct link *link, const SDL_ControllerSensorEvent *sensor) {
+    int kind = sensor->sensor == SDL_SENSOR_GYRO ? 0 : sensor->sensor == SDL_SENSOR_ACCEL ? 1 : -1;
+    if (kind < 0) {
+        return;
+    }
+#if SDL_VERSION_ATLEAST(2, 26, 0)
+    uint64_t time_us = sensor->timestamp_us ? sensor->timestamp_us : stats_now_ns() / 1000;
+#else
+    uint64_t time_us = stats_now_ns() / 1000;
+#endif
+    struct motion_filter *filter = &link->motion_filter;
+    if (filter->count[0] + filter->count[1] > 0 && time_us >= filter->window_end_us) {
+        // Fenêtre terminée : ses moyennes forment un échantillon
+        static const float scale[2] = { FRAME_GYRO_SCALE, FRAME_ACCEL_SCALE };
+        for (int k = 0; k < 2; k++) {
+            for (int i = 0; i < 3 && filter->count[k] > 0; i++) {
+                filter->last[k][i] = motion_quantize(filter->sum[k][i] / filter->count[k], scale[k]);
+                filter->sum[k][i] = 0;
+            }
+            filter->count[k] = 0;
+        }
+        motion_add_sample(link, filter->last_us);
+        // Fenêtres alignées sur la période, sauf après un trou dans les lectures
+        filter->window_end_us += filter->period_us;
+        if (time_us >= filter->window_end_us) {
+            filter->window_end_us = time_us + filter->period_us;
+        }
+    } else if (filter->count[0] + filter->count[1] == 0 && time_us >= filter->window_end_us) {
+        filter->window_end_us = time_us + filter->period_us; // première lecture
+    }
+    for (int i = 0; i < 3; i++) {
+        filter->sum[kind][i] += sensor->data[i];
+    }
+    filter->count[kind]++;
+    filter->last_us = time_us;
+}
+
+/**
+ * @brief Handles a touchpad event of the controller of a link: the first two fingers of the first touchpad.
+ *
+ * A touch alone is sent within MOTION_MAX_AGE_MS, in a frame without samples if the
+ * sensors are quiet.
+ */
+void motion_touchpad(struct link *link, const SDL_ControllerTouchpadEvent *touch) {
+    if (touch->touchpad != 0 || touch->finger < 0 || touch->finger > 1) {
+        return;
+    }
+    struct motion *motion = &link->motion;
+    if (motion->count == 0 && !link->motion_touched) {
+        link->motion_since = SDL_GetTicks();
+    }
+    uint8_t bit = (uint8_t)(1u << touch->finger);
+    if (touch->type == SDL_CONTROLLERTOUCHPADUP) {
+        motion->touch &= (uint8_t)~bit;
+    } else {
+        motion->touch |= bit;
+        motion->finger[touch->finger][0] = (uint16_t)(fminf(fmaxf(touch->x, 0), 1) * 65535 + 0.5f);
+        motion->finger[touch->finger][1] = (uint16_t)(fminf(fmaxf(touch->y, 0), 1) * 65535 + 0.5f);
+    }
+    link->motion_touched = 1;
+}
+
+/**
+ * @brief Sends the motion frames of the loop cycle, after the controller state.
+ *
+ * Motion must never delay the sticks and buttons: the frames only go when the socket
+ * has no queue and the robot has acknowledged all but MOTION_BACKLOG bytes (SIOCOUTQ),
+ * so they do not fill the Wi-Fi ahead of the next state. Otherwise they are dropped
+ * and counted; the samples carry their timestamps, so the robot sees the gap. Only the
+ * end of a partially written write is queued, to keep the TCP stream in sync.
+ */
+void link_send_motion(struct link *link) {
+    if ((link->motion.count > 0 || link->motion_touched)
+        && (int)(SDL_GetTicks() - link->motion_since) >= MOTION_MAX_AGE_MS) {
+        motion_close_batch(link);
+    }
+    if (link->motion_out_len == 0) {
+        return;
+    }
+    size_t len = link->motion_out_len;
+    int frames = link->motion_out_frames;
+    int samples = link->motion_out_samples;
+    link->motion_out_len = 0;
+    link->motion_out_frames = 0;
+    link->motion_out_samples = 0;
+    if (atomic_load(&link->status) != LINK_UP) {
+        link->stats.motion_dropped += frames;
+        return;
+    }
+    
+    if (link->rate_hz > 0) {
+        pthread_mutex_lock(&link->io_lock);
+    }
+    int backlog = 0;
+    ssize_t sent = -1;
+    if (link->queue.len == 0 && ioctl(link->sock, SIOCOUTQ, &backlog) == 0 && backlog <= MOTION_BACKLOG) {
+        sent = send(link->sock, link->motion_out, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent < 0 && !link->udp && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            link_fail(link);
+        }
+    }
+    if (sent >= 0 && (size_t)sent < len) {
+        // TCP : la fin de l'écriture commencée doit suivre, le robot se désynchroniserait sinon
+        struct iovec iov = { link->motion_out + sent, len - (size_t)sent };
+        if (queue_append(&link->queue, &iov, 1) != EXIT_SUCCESS) {
+            link_fail(link);
+        }
+    }
+    if (link->rate_hz > 0) {
+        pthread_mutex_unlock(&link->io_lock);
+    }
+    if (sent < 0) {
+        link->stats.motion_dropped += frames;
+        return;
+    }
+    link->stats.motion_frames += frames;
+    link->stats.motion_samples += samples;
+    link->stats.motion_bytes += len;
+}
+
+/**
+ * @brief Parses "ip[:port]" into a socket address, PORT by default.
+ *
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE if the address is invalid.
+ */
+int parse_address(const char *arg, struct sockaddr_in *addr) {
+    char ip[64];
+    int port = PORT;
+    const char *colon = strchr(arg, ':');
+    size_t len = colon ? (size_t)(colon - arg) : strlen(arg);
+    if (len == 0 || len >= sizeof(ip) || (colon && ((port = atoi(colon + 1)) <= 0 || port > 65535))) {
+        return EXIT_FAILURE;
+    }
+    memcpy(ip, arg, len);
+    ip[len] = '\0';
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(port);
+    return inet_pton(AF_INET, ip, &addr->sin_addr) == 1 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Reads the robots from a config file, one per line: "ip[:port] [nom]".
+ *
+ * Empty lines and what follows a '#' are ignored. Every robot gets the options of
+ * `model` (protocol, filter...). The n-th controller plugged in drives the n-th
+ * free robot.
+ *
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE if the file is unreadable or invalid.
+ */
+int fleet_load(struct fleet *fleet, const char *path, const struct link *model) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        printf("Impossible de lire %s\n", path);
+        return EXIT_FAILURE;
+    }
+    char line[256];
+    int number = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        number++;
+        char *comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        char address[128], name[sizeof(model->name)];
+        int fields = sscanf(line, "%127s %31s", address, name);
+        if (fields < 1) {
+            continue;
+        }
+        if (fleet->count == MAX_LINKS) {
+            printf("%s : %d robots au plus\n", path, MAX_LINKS);
+            fclose(file);
+            return EXIT_FAILURE;
+        }
+        struct link *link = &fleet->links[fleet->count];
+        *link = *model;
+        if (parse_address(address, &link->addr) != EXIT_SUCCESS) {
+            printf("%s ligne %d : adresse invalide %s\n", path, number, address);
+            fclose(file);
+            return EXIT_FAILURE;
+        }
+        snprintf(link->name, sizeof(link->name), "%.31s", fields == 2 ? name : address);
+        fleet->count++;
+    }
+    fclose(file);
+    if (fleet->count == 0) {
+        printf("Aucun robot dans %s\n", path);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Closes the socket of a link and schedules the next connection attempt.
+ *
+ * The delay starts at RECONNECT_MIN_MS and doubles after each failed attempt, up to
+ * RECONNECT_MAX_MS, so a robot that is switched off does not cost a connection
+ * attempt every loop cycle. Only the first failure is printed.
+ */
+void link_retry(struct link *link) {
+    int was_up = atomic_load(&link->status) == LINK_UP;
+    atomic_store(&link->status, LINK_DOWN);
+    
+    // Le thread d'envoi n'utilise plus la socket une fois le verrou rendu
+    pthread_mutex_lock(&link->io_lock);
+    if (link->sock >= 0) {
+        close(link->sock);
+    }
+    link->sock = -1;
+    link->queue.len = 0;
+    link->stale = 0;
+    pthread_mutex_unlock(&link->io_lock);
+    
+    if (was_up) {
+        link->stats.disconnects++;
+    }
+    if (link->backoff_ms == 0) {
+        link->backoff_ms = RECONNECT_MIN_MS;
+        printf("Connexion %s avec %s, nouvelle tentative dans %d ms\n", was_up ? "perdue" : "échouée", link->name,
+               link->backoff_ms);
+    } else if ((link->backoff_ms *= 2) > RECONNECT_MAX_MS) {
+        link->backoff_ms = RECONNECT_MAX_MS;
+    }
+    link->reconnect_at = SDL_GetTicks() + link->backoff_ms;
+}
+
+/**
+ * @brief Sends the whole controller state again after a connection.
+ *
+ * The robot may have restarted, or missed messages while the link was down. In
+ * binary mode the next frame already carries everything; in text mode every held
+ * button and every axis is sent again. With -H a heartbeat goes just before that
+ * frame: it arms the watchdog of the robot at once, even while the operator drives
+ * and no idle heartbeat would come.
+ */
+void link_resync(struct link *link) {
+    link->stale = 0;
+    link->taps = 0;
+    atomic_store(&link->resend, link->heartbeat_ms > 0);
+    if (link->texte) {
+        link->batch.text_len = 0;
+        for (int i = 0; i < FRAME_BTN_COUNT; i++) {
+            if (link->state.buttons & (1u << i)) {
+                batch_text(link, control_press_text[i].text, control_press_text[i].len);
+            }
+        }
+        memcpy(link->batch.axis, link->state.axes, sizeof(link->batch.axis));
+        link->batch.axis_dirty = (1u << FRAME_AXIS_COUNT) - 1;
+    }
+    publish_state(link);
+}
+
+/**
+ * @brief Completes a connection started by link_connect() once its socket is writable.
+ *
+ * @return Returns EXIT_SUCCESS if the link is up or still connecting, EXIT_FAILURE if
+ *         the connection failed (a new attempt is scheduled).
+ */
+int link_connected(struct link *link) {
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (getsockopt(link->sock, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0) {
+        link_retry(link);
+        return EXIT_FAILURE;
+    }
+    struct sockaddr_in peer;
+    socklen_t peer_len = sizeof(peer);
+    if (getpeername(link->sock, (struct sockaddr *)&peer, &peer_len) < 0) {
+        return EXIT_SUCCESS; // pas encore connecté
+    }
+    printf("Connexion établie avec %s !\n", link->name);
+    link->backoff_ms = 0;
+    link->rx.len = 0;
+    link->telemetry_rx = (struct frame_rx){0}; // le robot a peut-être redémarré
+    for (int i = 0; i < QUALITY_RING; i++) {
+        atomic_store_explicit(&link->quality.sent[i], 0, memory_order_relaxed);
+        link->quality.done[i] = 0;
+    }
+    link->quality.has_rtt = 0;
+    link->quality.loss = 0;
+    link_resync(link);
+    atomic_store(&link->status, LINK_UP);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Opens a non-blocking socket for a link and starts connecting it to its robot.
+ *
+ * Waits at most `wait_ms` for the connection; after that the link stays
+ * LINK_CONNECTING and the main loop completes it when the watcher reports the socket
+ * writable. Over UDP, connect() only sets the destination and the link is up at once.
+ *
+ * @param link (struct link *) The link to connect.
+ * @param wait_ms (int) Longest wait, 0 to return at once.
+ *
+ * @return Returns EXIT_SUCCESS if the link has a socket (up or connecting), otherwise
+ *         EXIT_FAILURE and a new attempt is scheduled.
+ */
+int link_connect(struct link *link, int wait_ms) {
+    // Create socket
+    int sock = socket(AF_INET, (link->udp ? SOCK_DGRAM : SOCK_STREAM) | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        printf("Erreur de creation socket\n");
+        link_retry(link);
+        return EXIT_FAILURE;
+    }
+    // Désactive Nagle : chaque trame part tout de suite au lieu d'attendre la suivante
+    int nodelay = 1;
+    if (!link->udp) {
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    }
+    pthread_mutex_lock(&link->io_lock);
+    link->sock = sock;
+    link->queue.len = 0;
+    pthread_mutex_unlock(&link->io_lock);
+    atomic_store(&link->status, LINK_CONNECTING);
+    
+    // Connect à l'ESP32 (en UDP, fixe seulement la destination des datagrammes)
+    if (connect(sock, (struct sockaddr *)&link->addr, sizeof(link->addr)) < 0 && errno != EINPROGRESS) {
+        link_retry(link);
+        return EXIT_FAILURE;
+    }
+    struct pollfd pfd = { .fd = sock, .events = POLLOUT };
+    if (wait_ms > 0 && poll(&pfd, 1, wait_ms) <= 0) {
+        return EXIT_SUCCESS;
+    }
+    return link_connected(link);
+}
+
+/**
+ * @brief Tells if the watcher must report the link socket as writable.
+ *
+ * In paced mode the sender thread drains its own queue at every tick.
+ */
+int link_wants_out(struct link *link) {
+    return atomic_load(&link->status) == LINK_CONNECTING || (link->rate_hz == 0 && link->queue.len > 0);
+}
+
+/**
+ * @brief Handles an event of the link socket reported by the watcher, then rearms it.
+ *
+ * @param link (struct link *) The link whose socket is ready.
+ * @param events (uint32_t) The epoll event mask.
+ * @param watcher (struct watcher *) The watcher of the sockets.
+ */
+void link_ready(struct link *link, uint32_t events, struct watcher *watcher) {
+    switch (atomic_load(&link->status)) {
+    case LINK_CONNECTING:
+        link_connected(link);
+        break;
+    
+    case LINK_UP:
+        if (receive(link) != EXIT_SUCCESS
+            || ((events & EPOLLOUT) && link->rate_hz == 0 && link_drain(link) != EXIT_SUCCESS)) {
+            link_retry(link);
+        }
+        break;
+    }
+    if (link->sock >= 0) {
+        link->watch_out = link_wants_out(link);
+        watcher_rearm(watcher, link->sock, link->watch_out);
+    }
+}
+
+/**
+ * @brief End of loop cycle housekeeping of a link: connection attempts, stall
+ *        detection and writability watching.
+ */
+void link_supervise(struct link *link, struct watcher *watcher) {
+    if (atomic_load(&link->status) == LINK_DOWN) {
+        if ((int)(SDL_GetTicks() - link->reconnect_at) >= 0 && link_connect(link, 0) == EXIT_SUCCESS) {
+            link->watch_out = 1;
+            watcher_add(watcher, link->sock, 1);
+        }
+        return;
+    }
+    if (link->rate_hz == 0 && link_stalled(link)) {
+        link_fail(link); // le watcher signale la socket fermée, la reconnexion suit
+    }
+    if (link_wants_out(link) != link->watch_out) {
+        link->watch_out = !link->watch_out;
+        watcher_rearm(watcher, link->sock, link->watch_out);
+    }
+}
+
+struct link *fleet_find_joystick(struct fleet *fleet, SDL_JoystickID id) {
+    for (int i = 0; i < fleet->count; i++) {
+        if (fleet->links[i].joystick == id) {
+            return &fleet->links[i];
+        }
+    }
+    return NULL;
+}
+
+struct link *fleet_find_socket(struct fleet *fleet, int sock) {
+    for (int i = 0; i < fleet->count; i++) {
+        if (fleet->links[i].sock == sock) {
+            return &fleet->links[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Turns on the motion sensors of the controller of a link (-g).
+ */
+void link_motion_start(struct link *link) {
+    static const SDL_SensorType sensors[2] = { SDL_SENSOR_GYRO, SDL_SENSOR_ACCEL };
+    static const char *sensor_names[2] = { "gyroscope", "accéléromètre" };
+    link->motion_filter = (struct motion_filter){ .period_us = 1000000 / link->motion_hz };
+    memset(&link->motion, 0, sizeof(link->motion));
+    link->motion_touched = 0;
+    for (int k = 0; k < 2; k++) {
+        if (!SDL_GameControllerHasSensor(link->controller, sensors[k])
+            || SDL_GameControllerSetSensorEnabled(link->controller, sensors[k], SDL_TRUE) < 0) {
+            printf("  pas de %s sur cette manette\n", sensor_names[k]);
+            continue;
+        }
+        printf("  %s à %.0f Hz, envoyé à %d Hz\n", sensor_names[k],
+               SDL_GameControllerGetSensorDataRate(link->controller, sensors[k]), link->motion_hz);
+    }
+}
+
+/**
+ * @brief Gives a newly plugged controller to the first robot without one.
+ *
+ * @param fleet (struct fleet *) The robots.
+ * @param device (int) SDL device index, from SDL_CONTROLLERDEVICEADDED.
+ */
+void fleet_attach(struct fleet *fleet, int device) {
+    SDL_GameController *controller = SDL_GameControllerOpen(device);
+    if (controller == NULL) {
+        printf("Impossible d'ouvrir la manette : %s\n", SDL_GetError());
+        return;
+    }
+    SDL_JoystickID id = SDL_JoystickInstanceID(SDL_GameControllerGetJoystick(controller));
+    if (fleet_find_joystick(fleet, id) != NULL) {
+        SDL_GameControllerClose(controller); // déjà attribuée
+        return;
+    }
+    for (int i = 0; i < fleet->count; i++) {
+        struct link *link = &fleet->links[i];
+        if (link->controller == NULL) {
+            link->controller = controller;
+            link->joystick = id;
+            printf("Manette detecter : %s -> %s\n", SDL_GameControllerName(controller), link->name);
+            SDL_GameControllerSetPlayerIndex(controller, i); // numéro du robot sur la manette
+            SDL_GameControllerRumble(controller, 0.5, 1, 500); // Fait vibrer la manette
+            SDL_GameControllerSetLED(controller, 0x00, 0xFF, 0x00); // Allume la LED de la manette en vert
+            link->led = 0x00FF00;
+            link->rumble_level = 0;
+            if (link->motion_hz > 0) {
+                link_motion_start(link);
+            }
+            return;
+        }
+    }
+    printf("Manette %s ignorée : aucun robot libre\n", SDL_GameControllerName(controller));
+    SDL_GameControllerClose(controller);
+}
+
 /**
- * @brief This file contains the implementation of a function to send a normalized float value to an ESP32 device.
- * 
- * The function `sendFloat` is designed to send a float value to an ESP32 over a socket connection. 
- * It normalizes the float value to a range of -1 to 1 and sends it in a formatted string if the 
- * difference between the new value and the old value exceeds a specified threshold.
- * 
- * @details
- * - The function checks if the absolute difference between the new value and the old value is greater than 0.1.
- * - If the condition is met, it formats the new value into a string with the specified name and normalization.
- * - The normalized value is calculated by dividing the new value by 2^15.
- * - The formatted string is sent to the ESP32 using the provided socket.
- * - The function returns 1 if the value is sent, otherwise it returns 0.
- * 
- * @param old_value (float) The previous float value to compare against.
- * @param new_value (float) The new float value to be sent if the condition is met.
- * @param name (char *) A string representing the name or identifier associated with the value.
- * @param sock (int) The socket descriptor used for sending the data.
- * 
- * @return Returns 1 if the value is sent successfully, otherwise returns 0.
- * 
- * @note The function assumes that the socket connection is already established and valid.
- * 
- * @warning Ensure that the buffer size for `float_data_to_esp` is sufficient to hold the formatted string.
- * 
- * @example
- * float old_val = 0.5;
- * float new_val = 0.7;
- * char *name = "Sensor1";
- * int socket = 3; // Example socket descriptor
- * int result = sendFloat(old_val, new_val, name, socket);
- * if (result) {
- *     printf("Value sent successfully.\n");
- * } else {
- *     printf("No significant change in value.\n");
- * }
- */ 
-int sendFloat(float old_value, float new_value, char *name, int sock) {
-    float sensibility = 0.05;
-    int max_value = pow(2,15);
-    
-    // si la differance entre avant et apres est superieur à 5% du max
-    if (abs(new_value - old_value) > sensibility*max_value) {
-        char float_data_to_esp[50];
-        sprintf(float_data_to_esp, "%s:%.2f\n", name, new_value/max_value); // normaliser de 1 à -1 avec 2 chiffre sign
-        printf("%s", float_data_to_esp);
-        send(sock, float_data_to_esp, strlen(float_data_to_esp), 0);
-        return EXIT_SUCCESS;
+ * @brief Brings a link back to a neutral state: every button released, every axis at 0.
+ *
+ * Goes through the usual handlers, so the robot receives the same messages as if
+ * the operator had let go of the controller.
+ */
+void link_neutral(struct link *link) {
+    SDL_Event event;
+    memset(&event, 0, sizeof(event));
+    event.type = SDL_CONTROLLERBUTTONUP;
+    for (int i = 0; i < FRAME_BTN_COUNT; i++) {
+        if (link->state.buttons & (1u << i)) {
+            event.cbutton.button = i;
+            release_button(event, link);
+        }
+    }
+    event.type = SDL_CONTROLLERAXISMOTION;
+    for (int i = 0; i < FRAME_AXIS_COUNT; i++) {
+        event.caxis.axis = i;
+        joystick(event, link);
     }
-    return EXIT_FAILURE;
 }
 
 /**
- * @brief Handles button press events from an SDL controller and sends corresponding data to an ESP device.
- * 
- * This function processes SDL controller button press events and sends a specific string
- * to the ESP device over a socket connection, depending on the button pressed.
- * 
- * @param event (type: SDL_Event) The SDL event containing information about the button press.
- * @param sock (int) The socket descriptor used for sending the data.
- * 
- * The function supports the following buttons:
- * - SDL_CONTROLLER_BUTTON_A: Sends "CroixP\n" (Cross button pressed).
- * - SDL_CONTROLLER_BUTTON_B: Sends "RondP\n" (Circle button pressed).
- * - SDL_CONTROLLER_BUTTON_X: Sends "CarreP\n" (Square button pressed).
- * - SDL_CONTROLLER_BUTTON_Y: Sends "TriangleP\n" (Triangle button pressed).
- * - SDL_CONTROLLER_BUTTON_BACK: Sends "SelectP\n" (Select button pressed).
- * - SDL_CONTROLLER_BUTTON_START: Sends "StartP\n" (Start button pressed).
- * - SDL_CONTROLLER_BUTTON_LEFTSHOULDER: Sends "L1P\n" (L1 button pressed).
- * - SDL_CONTROLLER_BUTTON_RIGHTSHOULDER: Sends "R1P\n" (R1 button pressed).
- * - SDL_CONTROLLER_BUTTON_LEFTSTICK: Sends "L3P\n" (L3 button pressed).
- * - SDL_CONTROLLER_BUTTON_RIGHTSTICK: Sends "R3P\n" (R3 button pressed).
- * - SDL_CONTROLLER_BUTTON_DPAD_UP: Sends "HautP\n" (D-pad up pressed).
- * - SDL_CONTROLLER_BUTTON_DPAD_DOWN: Sends "BasP\n" (D-pad down pressed).
- * - SDL_CONTROLLER_BUTTON_DPAD_LEFT: Sends "GaucheP\n" (D-pad left pressed).
- * - SDL_CONTROLLER_BUTTON_DPAD_RIGHT: Sends "DroitP\n" (D-pad right pressed).
- * - SDL_CONTROLLER_BUTTON_GUIDE: Sends "PsP\n" (PS button pressed).
- * - SDL_CONTROLLER_BUTTON_MISC1: Sends "TouchpadP\n" (Touchpad button pressed).
- * 
- * If the PS button (SDL_CONTROLLER_BUTTON_GUIDE) is pressed, the application is stopped.
- * 
- * @note The function uses the `send` function to transmit data over a socket.
- *       Ensure the `sock` variable is properly initialized and connected before calling this function.
- */
-int press_button(SDL_Event event, int sock) {
-    char *data_to_esp = "";
-    switch (event.cbutton.button){
-        case SDL_CONTROLLER_BUTTON_A : // Bouton Croix appuyé
-            data_to_esp = "CroixP\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
-            break;
-        case SDL_CONTROLLER_BUTTON_B : // Bouton Rond appuyé
-            data_to_esp = "RondP\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
-            break;
-        case SDL_CONTROLLER_BUTTON_X : // Bouton Carré appuyé
-            data_to_esp = "CarreP\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
-            break;
-        case SDL_CONTROLLER_BUTTON_Y : // Bouton Triangle appuyé
-            data_to_esp = "TriangleP\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
-            break;
-        case SDL_CONTROLLER_BUTTON_BACK : // Bouton Select appuyé
-            data_to_esp = "SelectP\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
-            break;
-        case SDL_CONTROLLER_BUTTON_START : // Bouton Start appuyé
-            data_to_esp = "StartP\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
-            break;
-        case SDL_CONTROLLER_BUTTON_LEFTSHOULDER : // Bouton L1 appuyé
-            data_to_esp = "L1P\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
-            break;
-        case SDL_CONTROLLER_BUTTON_RIGHTSHOULDER : // Bouton R1 appuyé
-            data_to_esp = "R1P\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
-            break;
-        case SDL_CONTROLLER_BUTTON_LEFTSTICK : // Bouton L3 appuyé
-            data_to_esp = "L3P\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
-            break;
-        case SDL_CONTROLLER_BUTTON_RIGHTSTICK : // Bouton R3 appuyé
-            data_to_esp = "R3P\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
-            break;
-        case SDL_CONTROLLER_BUTTON_DPAD_UP : // Bouton haut appuyé
-            data_to_esp = "HautP\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
-            break;
-        case SDL_CONTROLLER_BUTTON_DPAD_DOWN : // Bouton bas appuyé
-            data_to_esp = "BasP\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
-            break;
-        case SDL_CONTROLLER_BUTTON_DPAD_LEFT : // Bouton gauche appuyé
-            data_to_esp = "GaucheP\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
-            break;
-        case SDL_CONTROLLER_BUTTON_DPAD_RIGHT : // Bouton droit appuyé
-            data_to_esp = "DroitP\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
-            break;
-        case SDL_CONTROLLER_BUTTON_GUIDE : // Bouton PS appuyé
-            data_to_esp = "PsP\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
-            // Stoppe l'application
-            break;
-        case SDL_CONTROLLER_BUTTON_MISC1 : // Bouton Touchpad appuyé
-            data_to_esp = "TouchpadP\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
-            break;
-        
-        default:
-            return EXIT_FAILURE;
+ * @brief Handles an unplugged controller: its robot is stopped and can take another controller.
+ *
+ * @param fleet (struct fleet *) The robots.
+ * @param id (SDL_JoystickID) Instance id, from SDL_CONTROLLERDEVICEREMOVED.
+ */
+void fleet_detach(struct fleet *fleet, SDL_JoystickID id) {
+    struct link *link = fleet_find_joystick(fleet, id);
+    if (link == NULL) {
+        return;
+    }
+    SDL_GameControllerClose(link->controller);
+    link->controller = NULL;
+    link->joystick = -1;
+    link_neutral(link);
+    printf("Manette débranchée : %s à l'arrêt\n", link->name);
+    
+    // Une manette ignorée faute de robot libre peut maintenant le prendre
+    for (int device = 0; device < SDL_NumJoysticks(); device++) {
+        if (SDL_IsGameController(device)) {
+            fleet_attach(fleet, device);
         }
-        return EXIT_SUCCESS;
+    }
 }
 
 /**
- * @brief Handles joystick events and processes input from the controller's axes.
- * 
- * This function processes SDL joystick events and maps the input values from 
- * the controller's axes to corresponding variables. It also sends the processed 
- * values to a specified socket using the `sendFloat` function.
- * 
- * @param event (type: SDL_Event) The SDL event containing joystick axis data.
- * @param sock (int) The socket descriptor used for sending the data.
- * 
- * The function handles the following axes:
- * - SDL_CONTROLLER_AXIS_LEFTX: Left joystick horizontal axis.
- * - SDL_CONTROLLER_AXIS_LEFTY: Left joystick vertical axis.
- * - SDL_CONTROLLER_AXIS_RIGHTX: Right joystick horizontal axis.
- * - SDL_CONTROLLER_AXIS_RIGHTY: Right joystick vertical axis.
- * - SDL_CONTROLLER_AXIS_TRIGGERLEFT: Left trigger axis.
- * - SDL_CONTROLLER_AXIS_TRIGGERRIGHT: Right trigger axis.
- * 
- * For each axis, the function:
- * - Converts the axis value to a float.
- * - Sends the value to a socket with a specific identifier using `sendFloat`.
- * - Updates the corresponding variable with the new value.
- * 
- * If the axis does not match any of the handled cases, the function does nothing.
- */
-int joystick(SDL_Event event, int sock) {
-    float left_joy_x_value = 0.0;
-    float left_joy_y_value = 0.0;
-    float right_joy_x_value = 0.0;
-    float right_joy_y_value = 0.0;
-    float press_L2_value = 0.0;
-    float press_R2_value = 0.0;
-    float value_LX, value_LY, value_RX, value_RY, value_L2, value_R2;
-    
-    switch (event.caxis.axis){
-    case SDL_CONTROLLER_AXIS_LEFTX: // Joystick gauche X
-        value_LX = (float)(event.caxis.value);
-        sendFloat(left_joy_x_value, value_LX, "JGX", sock);
-        break;
-    case SDL_CONTROLLER_AXIS_LEFTY: // Joystick gauche Y
-        value_LY = (float)(event.caxis.value);
-        sendFloat(left_joy_y_value, value_LY, "JGY", sock);
-        break;
-    case SDL_CONTROLLER_AXIS_RIGHTX: // Joystick droit X
-        value_RX = (float)(event.caxis.value);
-        sendFloat(right_joy_x_value, value_RX, "JDX", sock);
-        break;
-    case SDL_CONTROLLER_AXIS_RIGHTY: // Joystick droit Y
-        value_RY = (float)(event.caxis.value);
-        sendFloat(right_joy_y_value, value_RY, "JDY", sock);
+ * @brief Routes a controller event to the robot of its controller and handles it.
+ */
+void dispatch_input(struct fleet *fleet, SDL_Event event) {
+    SDL_JoystickID id = event.type == SDL_CONTROLLERAXISMOTION ? event.caxis.which : event.cbutton.which;
+    struct link *link = fleet_find_joystick(fleet, id);
+    if (link == NULL) {
+        return;
+    }
+    link->stats.events++;
+    session_log_event(link->log, &event);
+    hist_add(&link->stats.stage[STAGE_EVENT], (uint64_t)(SDL_GetTicks() - event.common.timestamp) * 1000);
+    
+    switch (event.type) {
+    case SDL_CONTROLLERAXISMOTION: // Mouvement des joystick
+        joystick(event, link);
         break;
-    case SDL_CONTROLLER_AXIS_TRIGGERLEFT: // Gâchette gauche
-        value_L2 = (float)(event.caxis.value);
-        sendFloat(press_L2_value, value_L2, "GG", sock);
-        press_L2_value = value_L2;
+    
+    case SDL_CONTROLLERBUTTONDOWN: // Boutons appuyés
+        press_button(event, link);
         break;
-    case SDL_CONTROLLER_AXIS_TRIGGERRIGHT: // Gachette droite
-        value_R2 = (float)(event.caxis.value);
-        sendFloat(press_R2_value, value_R2, "GD", sock);
-        press_R2_value = value_R2;
+    
+    case SDL_CONTROLLERBUTTONUP: // Boutons relâchés
+        release_button(event, link);
         break;
-    default:
+    }
+}
+
+/**
+ * @brief Routes a motion sensor or touchpad event to the robot of its controller.
+ *
+ * These are not control inputs: they are neither timed nor recorded in the session,
+ * and they only fill the motion batch of the link (see link_send_motion()).
+ */
+void dispatch_motion(struct fleet *fleet, SDL_Event event) {
+    SDL_JoystickID id = event.type == SDL_CONTROLLERSENSORUPDATE ? event.csensor.which : event.ctouchpad.which;
+    struct link *link = fleet_find_joystick(fleet, id);
+    if (link == NULL || link->motion_hz == 0) {
+        return;
+    }
+    if (event.type == SDL_CONTROLLERSENSORUPDATE) {
+        motion_sensor(link, &event.csensor);
+    } else {
+        motion_touchpad(link, &event.ctouchpad);
+    }
+}
+
+/**
+ * @brief Time the main loop may sleep before a timer of any link is due, -1 for none.
+ */
+int fleet_timeout_ms(struct fleet *fleet) {
+    int timeout = -1;
+    for (int i = 0; i < fleet->count; i++) {
+        int delay = link_timeout_ms(&fleet->links[i]);
+        if (delay >= 0 && (timeout < 0 || delay < timeout)) {
+            timeout = delay;
+        }
+    }
+    return timeout;
+}
+
+/**
+ * @brief Renders the latest telemetry of a link on its controller.
+ *
+ * - LED: red on a fault, orange when the battery is low, green otherwise;
+ * - a strong rumble when a new fault appears;
+ * - a light rumble, stronger with the motor current, while the motors strain. It is
+ *   renewed as telemetry keeps coming, so it stops by itself if the robot goes silent.
+ *
+ * SDL is only called when the rendering changes, not for every telemetry frame.
+ * While the robot does not answer (-H), the controller stays red, see link_heartbeat().
+ */
+void link_feedback(struct link *link) {
+    SDL_GameController *controller = link->controller;
+    if (!link->has_telemetry || controller == NULL || link->dead) {
+        return;
+    }
+    const struct telemetry *telemetry = &link->telemetry;
+    
+    uint32_t led = 0x00FF00;
+    if (telemetry->faults & ~FRAME_FAULT_BATTERY) {
+        led = 0xFF0000;
+    } else if ((telemetry->faults & FRAME_FAULT_BATTERY) || telemetry->battery_pct < BATTERY_LOW_PCT) {
+        led = 0xFF8000;
+    }
+    if (led != link->led) {
+        SDL_GameControllerSetLED(controller, led >> 16, (led >> 8) & 0xFF, led & 0xFF);
+        link->led = led;
+    }
+    
+    Uint32 now = SDL_GetTicks();
+    uint16_t new_faults = telemetry->faults & ~link->signaled_faults;
+    link->signaled_faults = telemetry->faults;
+    if (new_faults) {
+        SDL_GameControllerRumble(controller, 0xFFFF, 0xFFFF, FAULT_RUMBLE_MS);
+        link->rumble_level = -1;
+        link->rumble_until = now + FAULT_RUMBLE_MS;
+        return;
+    }
+    
+    // Vibration de charge : 4 niveaux entre CURRENT_RUMBLE_MA et CURRENT_FULL_MA
+    int current = abs(telemetry->current_ma[0]) > abs(telemetry->current_ma[1])
+                ? abs(telemetry->current_ma[0]) : abs(telemetry->current_ma[1]);
+    int level = 0;
+    if (current > CURRENT_RUMBLE_MA) {
+        level = current >= CURRENT_FULL_MA ? 4 : 1 + 3 * (current - CURRENT_RUMBLE_MA) / (CURRENT_FULL_MA - CURRENT_RUMBLE_MA);
+    }
+    int rumbling = (int)(now - link->rumble_until) < 0;
+    if ((rumbling && (link->rumble_level < 0 || link->rumble_level == level)) || (!rumbling && level == 0)) {
+        return;
+    }
+    SDL_GameControllerRumble(controller, (Uint16)(level * 0xFFFF / 4), 0, level ? LOAD_RUMBLE_MS : 0);
+    link->rumble_level = level;
+    link->rumble_until = now + LOAD_RUMBLE_MS / 2; // renouvelée avant la fin, sans trou
+}
+
+/**
+ * @brief Keeps the link from going silent and notices a robot that stopped answering (-H).
+ *
+ * In direct mode a heartbeat frame (the 4-byte header) goes out when nothing was sent
+ * for heartbeat_ms, and the full state every refresh_ms: the watchdog of the robot
+ * (struct frame_watchdog in frame.h) is fed with the sticks held still, and a state
+ * the robot lost comes back. In paced mode the sender thread does the same at its
+ * ticks (see sender_tick()).
+ *
+ * Heartbeats are acknowledged like state frames. After HEARTBEAT_DEAD intervals
+ * without any acknowledgement from the robot the link is dead, even if telemetry
+ * still comes: the controller turns red and rumbles until the robot acknowledges
+ * again, then the full state is sent at once.
+ */
+void link_heartbeat(struct link *link) {
+    if (link->heartbeat_ms == 0) {
+        return;
+    }
+    Uint32 now = SDL_GetTicks();
+    SDL_GameController *controller = link->controller;
+    int silent = (int)(now - link->heard_at) >= HEARTBEAT_DEAD * link->heartbeat_ms;
+    if (silent && !link->dead) {
+        link->dead = 1;
+        link->stats.link_lost++;
+        printf("Liaison %s perdue : aucun acquittement depuis %d ms\n", link->name, (int)(now - link->heard_at));
+        if (controller != NULL) {
+            SDL_GameControllerSetLED(controller, 0xFF, 0, 0);
+            SDL_GameControllerRumble(controller, 0xFFFF, 0xFFFF, FAULT_RUMBLE_MS);
+        }
+        link->led = 0xFF0000;
+        link->rumble_level = -1;
+        link->rumble_until = now + FAULT_RUMBLE_MS;
+    } else if (!silent && link->dead) {
+        link->dead = 0;
+        printf("Liaison %s rétablie\n", link->name);
+        if (controller != NULL && !link->has_telemetry) {
+            // Sans télémétrie, link_feedback() ne touche pas la LED : elle redevient verte ici
+            SDL_GameControllerSetLED(controller, 0, 0xFF, 0);
+            link->led = 0x00FF00;
+        }
+        // Le chien de garde du robot l'a peut-être arrêté : il lui faut l'état complet
+        atomic_store(&link->resend, 1);
+        publish_state(link);
+        link_flush(link);
+    }
+    
+    if (link->rate_hz > 0 || atomic_load(&link->status) != LINK_UP || link->queue.len > 0) {
+        return;
+    }
+    if ((int)(now - link->refresh_at) >= link->refresh_ms) {
+        publish_state(link);
+        link_flush(link);
+    } else if ((int)(now - link->sent_at) >= link->heartbeat_ms) {
+        uint8_t frame[FRAME_HEADER_SIZE];
+        uint16_t seq = link->seq++;
+        size_t len = frame_encode_heartbeat(frame, seq);
+        uint64_t encode_ns = stats_now_ns();
+        link_write(link, frame, len, 1);
+        stats_sent(&link->stats, 0, encode_ns, stats_now_ns());
+        quality_sent(link, seq);
+        link->stats.heartbeats++;
+        link->sent_at = now;
+    }
+}
+
+/**
+ * @brief Counts the state frames never acknowledged and, with -A, moves the operating point of the link.
+ *
+ * Runs every QUALITY_MS. Before the first ACK of a connection nothing is counted, so
+ * a robot that does not acknowledge keeps the configured settings. A congested link
+ * goes a quarter of the way to the coarsest point at once and comes back by 1/20
+ * steps while it is clean: backing off must be faster than the queues grow, coming
+ * back must not refill them. The rate moves geometrically between -r and hz_min, the
+ * axis sensitivity linearly between -s and smax.
+ */
+void link_quality(struct link *link) {
+    struct link_quality *quality = &link->quality;
+    Uint32 now = SDL_GetTicks();
+    if ((int)(now - quality->next_at) < 0) {
+        return;
+    }
+    quality->next_at = now + QUALITY_MS;
+    if (!quality->has_rtt) {
+        return;
+    }
+    
+    uint64_t now_us = stats_now_ns() / 1000;
+    double timeout_us = fmax(4 * quality->srtt_us, QUALITY_LOSS_MIN_MS * 1000.0);
+    for (int i = 0; i < QUALITY_RING; i++) {
+        uint64_t sent = atomic_load_explicit(&quality->sent[i], memory_order_relaxed);
+        if (sent == 0 || (quality->done[i] & ~QUALITY_ACKED) == sent) {
+            continue;
+        }
+        if ((double)((now_us - sent) & QUALITY_TIME_MASK) > timeout_us) {
+            quality->done[i] = sent;
+            link->stats.lost++;
+            quality->loss += (1 - quality->loss) / 32;
+        }
+    }
+    if ((int)(now - quality->window_at) >= 0) {
+        quality->min_rtt_us = quality->window_min_us;
+        quality->window_min_us = quality->srtt_us;
+        quality->window_at = now + QUALITY_MIN_WINDOW_MS;
+    }
+    if (!quality->adaptive) {
+        return;
+    }
+    
+    double delay_ms = (quality->srtt_us - quality->min_rtt_us) / 1000;
+    int congested = delay_ms > QUALITY_DELAY_MS || quality->loss * 100 > QUALITY_LOSS_PCT;
+    if (congested) {
+        quality->level = fminf(1, quality->level + 0.25f);
+    } else if (delay_ms < QUALITY_CLEAN_MS && quality->loss * 100 < QUALITY_CLEAN_PCT) {
+        quality->level = fmaxf(0, quality->level - 0.05f);
+    }
+    link->filter.delta = quality->delta_min + quality->level * (quality->delta_max - quality->delta_min);
+    if (link->rate_hz > 0) {
+        atomic_store(&link->send_hz, (int)lroundf(link->rate_hz * powf((float)quality->hz_min / link->rate_hz,
+                                                                           quality->level)));
+    }
+    // Un message au début de l'encombrement, un autre au retour au point le plus fin
+    if (congested ? !quality->backed_off : (quality->backed_off && quality->level == 0)) {
+        quality->backed_off = congested;
+        printf("Liaison %s %s (file %.0f ms, pertes %.1f%%) : sensibilité %.1f%%", link->name,
+               congested ? "encombrée" : "rétablie", delay_ms, quality->loss * 100, link->filter.delta * 100);
+        printf(link->rate_hz > 0 ? ", %d Hz\n" : "\n", atomic_load(&link->send_hz));
+    }
+}
+
+/**
+ * @brief Prints the telemetry of every robot on one status line.
+ *
+ * In a terminal the line is rewritten in place every STATUS_MS; when the output goes
+ * to a file, a new line is written every STATUS_LOG_MS. Nothing is printed while no
+ * new telemetry arrived.
+ */
+void fleet_status(struct fleet *fleet) {
+    Uint32 now = SDL_GetTicks();
+    if ((int)(now - fleet->status_at) < 0) {
+        return;
+    }
+    unsigned long long telemetry = 0;
+    for (int i = 0; i < fleet->count; i++) {
+        telemetry += fleet->links[i].stats.telemetry;
+    }
+    if (telemetry == fleet->status_telemetry) {
+        return;
+    }
+    fleet->status_telemetry = telemetry;
+    int tty = isatty(STDOUT_FILENO);
+    fleet->status_at = now + (tty ? STATUS_MS : STATUS_LOG_MS);
+    
+    char line[512];
+    int len = 0;
+    for (int i = 0; i < fleet->count && len < (int)sizeof(line); i++) {
+        struct link *link = &fleet->links[i];
+        const struct telemetry *t = &link->telemetry;
+        if (!link->has_telemetry) {
+            continue;
+        }
+        len += snprintf(line + len, sizeof(line) - len, "%s%s %.1f V %u%% %d°C moteurs %.1f/%.1f A",
+                        len ? " | " : "", link->name, t->battery_mv / 1000.0, t->battery_pct, t->temperature_c,
+                        t->current_ma[0] / 1000.0, t->current_ma[1] / 1000.0);
+        for (int f = 0; f < FRAME_FAULT_COUNT && len < (int)sizeof(line); f++) {
+            if (t->faults & (1u << f)) {
+                len += snprintf(line + len, sizeof(line) - len, " [%s]", frame_fault_names[f]);
+            }
+        }
+    }
+    printf(tty ? "\r%s\033[K" : "%s\n", line);
+    fflush(stdout);
+}
+
+/**
+ * @brief Puts a thread of the input and send path in real time: SCHED_FIFO at `priority`, pinned to `cpu`.
+ *
+ * @param thread (pthread_t) The thread.
+ * @param priority (int) SCHED_FIFO priority, 0 to keep the normal scheduler.
+ * @param cpu (int) CPU to pin the thread to, -1 for any.
+ *
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE with errno set (usually missing privileges).
+ */
+int realtime_thread(pthread_t thread, int priority, int cpu) {
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if ((errno = pthread_setaffinity_np(thread, sizeof(set), &set)) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+    if (priority > 0) {
+        struct sched_param param = { .sched_priority = priority };
+        if ((errno = pthread_setschedparam(thread, SCHED_FIFO, &param)) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Keeps the process in RAM so the loop never waits for a page fault.
+ *
+ * Every buffer of the loop is static or inside struct link, and the threads' stacks
+ * are mapped already: mlockall() brings them all in and keeps them there. The heap is
+ * never returned to the system nor served by mmap, so what SDL allocates later stays
+ * locked too, and the stack of the calling thread is touched down to
+ * REALTIME_STACK_PREFAULT since it only grows on demand.
+ *
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE with errno set.
+ */
+int realtime_lock_memory(void) {
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
         return EXIT_FAILURE;
     }
+    volatile uint8_t stack[REALTIME_STACK_PREFAULT];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) {
+        stack[i] = 0;
+    }
     return EXIT_SUCCESS;
 }
 
 /**
- * @brief Handles the release of buttons on an SDL controller and sends corresponding data to an ESP device.
+ * @brief Real-time mode (-R, -C): the main loop, the sender thread and the socket watcher.
  *
- * This function processes SDL controller button release events and sends a specific string
- * to the ESP device over a socket connection, indicating which button was released.
+ * Only the threads on the path from the controller to the socket are concerned; the
+ * session writer and the benchmark keep the normal scheduler, so writing to disk or
+ * generating events cannot hold the CPU of the loop. Linux still caps real-time threads
+ * to 95% of each second (sched_rt_runtime_us), so a runaway loop cannot freeze the
+ * machine.
  *
- * @param event (type: SDL_Event) The SDL event containing information about the button release.
- * @param sock (int) The socket descriptor used for sending the data.
- * 
- * The function supports the following buttons:
- * - SDL_CONTROLLER_BUTTON_A: Sends "CroixR\n" for the A button release.
- * - SDL_CONTROLLER_BUTTON_B: Sends "RondR\n" for the B button release.
- * - SDL_CONTROLLER_BUTTON_X: Sends "CarreR\n" for the X button release.
- * - SDL_CONTROLLER_BUTTON_Y: Sends "TriangleR\n" for the Y button release.
- * - SDL_CONTROLLER_BUTTON_BACK: Sends "SelectR\n" for the Back button release.
- * - SDL_CONTROLLER_BUTTON_START: Sends "StartR\n" for the Start button release.
- * - SDL_CONTROLLER_BUTTON_LEFTSHOULDER: Sends "L1R\n" for the Left Shoulder button release.
- * - SDL_CONTROLLER_BUTTON_RIGHTSHOULDER: Sends "R1R\n" for the Right Shoulder button release.
- * - SDL_CONTROLLER_BUTTON_LEFTSTICK: Sends "L3R\n" for the Left Stick button release.
- * - SDL_CONTROLLER_BUTTON_RIGHTSTICK: Sends "R3R\n" for the Right Stick button release.
- * - SDL_CONTROLLER_BUTTON_DPAD_UP: Sends "HautR\n" for the D-Pad Up button release.
- * - SDL_CONTROLLER_BUTTON_DPAD_DOWN: Sends "BasR\n" for the D-Pad Down button release.
- * - SDL_CONTROLLER_BUTTON_DPAD_LEFT: Sends "GaucheR\n" for the D-Pad Left button release.
- * - SDL_CONTROLLER_BUTTON_DPAD_RIGHT: Sends "DroiteR\n" for the D-Pad Right button release.
- * - SDL_CONTROLLER_BUTTON_GUIDE: Sends "PsR\n" for the Guide button release.
- * - SDL_CONTROLLER_BUTTON_MISC1: Sends "TouchpadR\n" for the Touchpad button release.
- *
- * If the button is not recognized, the function does nothing.
- *
- * @note The function uses the `send` function to transmit data over a socket.
- *       Ensure the socket (`sock`) and the `data_to_esp` variable are properly initialized
- *       before calling this function.
- */
-int release_button(SDL_Event event, int sock) {
-    char *data_to_esp = "";
-    switch (event.cbutton.button){
-        case SDL_CONTROLLER_BUTTON_A : // Bouton Croix relâché
-            data_to_esp = "CroixR\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE after printing the reason.
+ */
+int realtime_start(struct fleet *fleet, struct watcher *watcher, int priority, int cpu) {
+    if (priority > 0 && realtime_lock_memory() != EXIT_SUCCESS) {
+        printf("Impossible de verrouiller la mémoire : %s\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (realtime_thread(pthread_self(), priority, cpu) != EXIT_SUCCESS
+        || (fleet->links[0].rate_hz > 0 && realtime_thread(fleet->sender, priority, cpu) != EXIT_SUCCESS)
+        || realtime_thread(watcher->thread, priority, cpu) != EXIT_SUCCESS) {
+        printf("Impossible de passer en temps réel : %s (lancer avec sudo)\n", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (priority > 0) {
+        printf("Temps réel : SCHED_FIFO priorité %d, mémoire verrouillée", priority);
+    } else {
+        printf("Boucle");
+    }
+    printf(cpu >= 0 ? ", sur le CPU %d\n" : "\n", cpu);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    static struct fleet fleet;
+    struct link model = {0}; // options communes à tous les robots
+    axis_filter_init(&model.filter);
+    model.sock = -1;
+    model.joystick = -1;
+    char *csv_path = NULL;
+    char *address = NULL;
+    char *fleet_path = NULL;
+    struct bench bench;
+    int benchmark = 0;
+    struct session_log log;
+    char *log_path = NULL;
+    float adapt_delta = 0; // -A : sensibilité la plus grossière en %, 0 sans adaptation
+    int adapt_hz = 0;
+    int rt_priority = 0; // -R : priorité SCHED_FIFO, 0 sans temps réel
+    int rt_cpu = -1; // -C : CPU de la boucle, -1 pour n'importe lequel
+    char inject_name[64] = ""; // -i : segment de l'injection locale, vide sans injection
+    int takeover_button = FRAME_BTN_PS;
+    int refresh_ms = 0; // -H : état complet au moins à cet intervalle, 0 pour HEARTBEAT_REFRESH battements
+    
+    // Options de la ligne de commande
+    int opt;
+    while ((opt = getopt(argc, argv, "tr:uz:c:s:o:a:b:w:p:m:g:A:R:C:i:H:")) != -1) {
+        switch (opt) {
+        case 't': // Ancien protocole texte, pour les ESP32 pas encore mis à jour
+            model.texte = 1;
+            break;
+        case 'r': // Envoi cadencé par un thread dédié
+            model.rate_hz = atoi(optarg);
+            if (model.rate_hz <= 0 || model.rate_hz > 10000) {
+                printf("Fréquence invalide : %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'u': // Datagrammes UDP : une trame perdue n'en retarde pas d'autres
+            model.udp = 1;
             break;
-        case SDL_CONTROLLER_BUTTON_B : // Bouton Rond relâché
-            data_to_esp = "RondR\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
+        case 'z': // Zones mortes en % : joysticks,gâchettes
+            if (sscanf(optarg, "%f,%f", &model.filter.stick.deadzone, &model.filter.trigger.deadzone) != 2
+                || model.filter.stick.deadzone < 0 || model.filter.stick.deadzone >= 100
+                || model.filter.trigger.deadzone < 0 || model.filter.trigger.deadzone >= 100) {
+                printf("Zones mortes invalides : %s\n", optarg);
+                return -1;
+            }
+            model.filter.stick.deadzone /= 100;
+            model.filter.trigger.deadzone /= 100;
             break;
-        case SDL_CONTROLLER_BUTTON_X : // Bouton Carré relâché
-            data_to_esp = "CarreR\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
+        case 'c': // Courbe de réponse des joysticks
+            model.filter.stick.expo = atof(optarg);
+            if (model.filter.stick.expo <= 0) {
+                printf("Courbe invalide : %s\n", optarg);
+                return -1;
+            }
             break;
-        case SDL_CONTROLLER_BUTTON_Y : // Bouton Triangle relâché
-            data_to_esp = "TriangleR\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
+        case 's': // Variation minimale avant un nouvel envoi, en %
+            model.filter.delta = atof(optarg) / 100;
+            if (model.filter.delta < 0 || model.filter.delta >= 1) {
+                printf("Sensibilité invalide : %s\n", optarg);
+                return -1;
+            }
             break;
-        case SDL_CONTROLLER_BUTTON_BACK : // Bouton Select relâché
-            data_to_esp = "SelectR\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
+        case 'o': // Statistiques en CSV à la sortie
+            csv_path = optarg;
             break;
-        case SDL_CONTROLLER_BUTTON_START : // Bouton Start relâché
-            data_to_esp = "StartR\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
+        case 'a': // Adresse du robot, ex. 127.0.0.1:8080 pour mock_robot
+            address = optarg;
             break;
-        case SDL_CONTROLLER_BUTTON_LEFTSHOULDER : // Bouton L1 relâché
-            data_to_esp = "L1R\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
+        case 'm': // Plusieurs robots, une manette chacun
+            fleet_path = optarg;
             break;
-        case SDL_CONTROLLER_BUTTON_RIGHTSHOULDER : // Bouton R1 relâché
-            data_to_esp = "R1R\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
+        case 'g': // Gyroscope, accéléromètre et pavé tactile de la manette
+            model.motion_hz = atoi(optarg);
+            if (model.motion_hz <= 0 || model.motion_hz > MOTION_MAX_HZ) {
+                printf("Fréquence du mouvement invalide : %s\n", optarg);
+                return -1;
+            }
             break;
-        case SDL_CONTROLLER_BUTTON_LEFTSTICK : // Bouton L3 relâché
-            data_to_esp = "L3R\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
+        case 'A': // Adapte le débit et la sensibilité à la qualité mesurée de la liaison
+            if (sscanf(optarg, "%f,%d", &adapt_delta, &adapt_hz) < 1 || adapt_delta <= 0 || adapt_delta >= 100
+                || adapt_hz < 0) {
+                printf("Adaptation invalide : %s\n", optarg);
+                return -1;
+            }
             break;
-        case SDL_CONTROLLER_BUTTON_RIGHTSTICK : // Bouton R3 relâché
-            data_to_esp = "R3R\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
+        case 'R': // Temps réel : boucle et envoi en SCHED_FIFO, mémoire verrouillée
+            rt_priority = atoi(optarg);
+            if (rt_priority < sched_get_priority_min(SCHED_FIFO) || rt_priority > sched_get_priority_max(SCHED_FIFO)) {
+                printf("Priorité invalide : %s (1 à 99)\n", optarg);
+                return -1;
+            }
             break;
-        case SDL_CONTROLLER_BUTTON_DPAD_UP : // Bouton haut relâché
-            data_to_esp = "HautR\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
+        case 'C': // Fixe la boucle et l'envoi sur un CPU
+            rt_cpu = atoi(optarg);
+            if (rt_cpu < 0 || rt_cpu >= sysconf(_SC_NPROCESSORS_CONF) || rt_cpu >= CPU_SETSIZE) {
+                printf("CPU invalide : %s\n", optarg);
+                return -1;
+            }
             break;
-        case SDL_CONTROLLER_BUTTON_DPAD_DOWN : // Bouton bas relâché
-            data_to_esp = "BasR\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
+        case 'i': { // Injection locale : d'autres processus du poste commandent aussi le robot
+            const char *comma = strchr(optarg, ',');
+            size_t len = comma ? (size_t)(comma - optarg) : strlen(optarg);
+            snprintf(inject_name, sizeof(inject_name), "%.*s", (int)len, optarg);
+            if (len == 0) {
+                snprintf(inject_name, sizeof(inject_name), "%s", INJECT_DEFAULT_NAME);
+            }
+            if (comma != NULL) {
+                takeover_button = -1;
+                for (int i = 0; i < FRAME_BTN_COUNT; i++) {
+                    if (strcmp(comma + 1, control_button_name[i].text) == 0) {
+                        takeover_button = i;
+                    }
+                }
+            }
+            if (inject_name[0] != '/' || strchr(inject_name + 1, '/') != NULL || takeover_button < 0) {
+                printf("Injection invalide : %s (ex. %s,%s)\n", optarg, INJECT_DEFAULT_NAME,
+                       control_button_name[FRAME_BTN_PS].text);
+                return -1;
+            }
             break;
-        case SDL_CONTROLLER_BUTTON_DPAD_LEFT : // Bouton gauche relâché
-            data_to_esp = "GaucheR\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
+        }
+        case 'H': // Battement de cœur : le robot s'arrête, et la manette le signale, si la liaison meurt
+            if (sscanf(optarg, "%d,%d", &model.heartbeat_ms, &refresh_ms) < 1 || model.heartbeat_ms < HEARTBEAT_MIN_MS
+                || model.heartbeat_ms > HEARTBEAT_MAX_MS || (refresh_ms != 0 && refresh_ms < model.heartbeat_ms)) {
+                printf("Battement invalide : %s (%d à %d ms, puis l'intervalle de l'état complet)\n", optarg,
+                       HEARTBEAT_MIN_MS, HEARTBEAT_MAX_MS);
+                return -1;
+            }
             break;
-        case SDL_CONTROLLER_BUTTON_DPAD_RIGHT : // Bouton droit relâché
-            data_to_esp = "DroiteR\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
+        case 'b': // Banc d'essai : évènements synthétiques, sans manette
+            if (bench_parse(&bench, optarg) != EXIT_SUCCESS) {
+                printf("Banc invalide : %s (sine, jitter, mash ou mix[,hz[,secondes]])\n", optarg);
+                return -1;
+            }
+            benchmark = 1;
             break;
-        case SDL_CONTROLLER_BUTTON_GUIDE : // Bouton PS relâché
-            data_to_esp = "PsR\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
-            // close(sock);
-            // exit(0);
+        case 'w': // Enregistre les évènements et les messages envoyés
+            log_path = optarg;
             break;
-        case SDL_CONTROLLER_BUTTON_MISC1 : // Bouton Touchpad relâché
-            data_to_esp = "TouchpadR\n";
-            send(sock, data_to_esp, strlen(data_to_esp), 0);
+        case 'p': // Rejoue une session enregistrée, sans manette
+            if (bench_parse_replay(&bench, optarg) != EXIT_SUCCESS) {
+                printf("Session illisible : %s\n", optarg);
+                return -1;
+            }
+            benchmark = 1;
             break;
         default:
-            return EXIT_FAILURE;
+            printf("Usage : %s [-t] [-r hz] [-u] [-z joy,gach] [-c expo] [-s delta] [-o stats.csv] [-a ip[:port]] [-m robots.conf] [-g hz] [-A smax[,hzmin]] [-R prio] [-C cpu] [-i nom[,bouton]] [-H ms[,ms]] [-b motif[,hz[,s]]] [-w session.log] [-p session.log[,fast]]\n", argv[0]);
+            printf("  -t     envoie l'ancien protocole texte au lieu des trames binaires\n");
+            printf("  -r hz  envoie l'état complet hz fois par seconde depuis un thread dédié (ex. 100, 250, 500)\n");
+            printf("  -u     envoie les trames en UDP au lieu de TCP\n");
+            printf("  -z j,g zones mortes en %% des joysticks (radiale) et des gâchettes (défaut 8,3)\n");
+            printf("  -c e   courbe de réponse des joysticks, sortie = entrée^e (défaut 1, linéaire)\n");
+            printf("  -s d   variation minimale en %% avant de renvoyer un axe (défaut 1)\n");
+            printf("  -o f   écrit les statistiques de latence et de débit dans le CSV f à la sortie\n");
+            printf("  -a ip  adresse[:port] du robot (défaut %s:%d)\n", SERVER_IP, PORT);
+            printf("  -m f   pilote plusieurs robots, un par ligne \"ip[:port] [nom]\" du fichier f,\n");
+            printf("         la n-ième manette branchée pilote le n-ième robot libre\n");
+            printf("  -g hz  envoie aussi le gyroscope, l'accéléromètre et le pavé tactile, moyennés à hz échantillons/s\n");
+            printf("  -A s,h adapte l'envoi à l'aller-retour et aux pertes mesurés : sur une liaison encombrée,\n");
+            printf("         la sensibilité monte jusqu'à s %% et la fréquence de -r descend jusqu'à h Hz (défaut -r / 4)\n");
+            printf("  -R p   temps réel : boucle et envoi en SCHED_FIFO de priorité p (1 à 99), mémoire verrouillée\n");
+            printf("  -C n   fixe la boucle et l'envoi sur le CPU n\n");
+            printf("  -i n,b ouvre la mémoire partagée n (ex. %s) aux processus locaux qui commandent aussi\n",
+                   INJECT_DEFAULT_NAME);
+            printf("         le robot ; tenir le bouton b (défaut %s) rend la main à la manette\n",
+                   control_button_name[FRAME_BTN_PS].text);
+            printf("  -H h,r envoie un battement toutes les h ms sans autre envoi, l'état complet toutes les r ms\n");
+            printf("         (défaut %d h) ; sans réponse du robot pendant %d h, la manette passe au rouge et vibre ;\n",
+                   HEARTBEAT_REFRESH, HEARTBEAT_DEAD);
+            printf("         h de %d à %d ms, le robot s'arrête après %d ms sans trame\n", HEARTBEAT_MIN_MS,
+                   HEARTBEAT_MAX_MS, FRAME_WATCHDOG_MS);
+            printf("  -b m   banc d'essai sans manette : injecte le motif m (sine, jitter, mash, mix),\n");
+            printf("         ex. sine,2000,10 pour 2000 évènements/s pendant 10 s, vers un puits local sauf avec -a\n");
+            printf("  -w f   enregistre les évènements manette et les messages envoyés dans le journal f\n");
+            printf("  -p f   rejoue le journal f sans manette, en temps réel, ou au plus vite avec f,fast\n");
+            return -1;
         }
-        return EXIT_SUCCESS;
-}
-
-int main(int argc, char *argv[]) {
+    }
+    if (model.texte && (model.rate_hz > 0 || model.udp || model.motion_hz > 0 || adapt_delta > 0 || inject_name[0]
+                        || model.heartbeat_ms > 0)) {
+        printf("Le mode cadencé (-r), l'UDP (-u), le mouvement (-g), l'adaptation (-A), l'injection (-i) et le battement (-H)"
+               " n'existent qu'avec le protocole binaire\n");
+        return -1;
+    }
+    if (model.heartbeat_ms > 0) {
+        model.refresh_ms = refresh_ms > 0 ? refresh_ms : HEARTBEAT_REFRESH * model.heartbeat_ms;
+        if (model.rate_hz > 0 && model.heartbeat_ms * model.rate_hz < 1000) {
+            printf("Battement invalide : en mode cadencé il doit durer au moins une période de -r (%d ms)\n",
+                   (1000 + model.rate_hz - 1) / model.rate_hz);
+            return -1;
+        }
+    }
+    if (adapt_delta > 0) {
+        // Point le plus fin : -s et -r ; le plus grossier : -A
+        model.quality.adaptive = 1;
+        model.quality.delta_min = model.filter.delta;
+        model.quality.delta_max = adapt_delta / 100;
+        model.quality.hz_min = adapt_hz > 0 ? adapt_hz : (model.rate_hz >= 4 ? model.rate_hz / 4 : 1);
+        if (model.quality.delta_max < model.quality.delta_min || (model.rate_hz > 0 && model.quality.hz_min > model.rate_hz)) {
+            printf("Adaptation invalide : les limites de -A doivent être plus grossières que -s et -r\n");
+            return -1;
+        }
+    }
+    atomic_store(&model.send_hz, model.rate_hz);
+    if (address != NULL && fleet_path != NULL) {
+        printf("-a et -m s'excluent : mettez l'adresse dans %s\n", fleet_path);
+        return -1;
+    }
+    
     // Initialisation de SDL
     if (SDL_Init(SDL_INIT_GAMECONTROLLER) < 0) {
         printf("Erreur d'initialisation de SDL : %s\n", SDL_GetError());
         return -1;
     }
     
-    printf("Recherche de manettes...\n");
-    
-    // Vérifie si une manette est connectée
-    if (SDL_NumJoysticks() < 1) {
-        printf("Aucune manette détectée.\n");
-        SDL_Quit();
-        return -1;
+    // Liste des robots : un seul (-a ou défaut), ou le fichier de -m
+    if (fleet_path != NULL) {
+        if (fleet_load(&fleet, fleet_path, &model) != EXIT_SUCCESS) {
+            return -1;
+        }
+    } else {
+        char sink_address[32];
+        if (benchmark && address == NULL) {
+            // Pas de robot : les trames partent vers un puits local
+            int port = PORT;
+            if (bench_sink_start(&bench, model.udp, &port) != EXIT_SUCCESS) {
+                printf("Impossible de lancer le puits local\n");
+                return -1;
+            }
+            snprintf(sink_address, sizeof(sink_address), "127.0.0.1:%d", port);
+            address = sink_address;
+        }
+        fleet.links[0] = model;
+        fleet.count = 1;
+        snprintf(fleet.links[0].name, sizeof(fleet.links[0].name), "%s", address ? address : SERVER_IP);
+        if (parse_address(address ? address : SERVER_IP, &fleet.links[0].addr) != EXIT_SUCCESS) {
+            printf("Adresse invalide : %s\n", address);
+            return -1;
+        }
     }
-    // Ouvre la  manette
-    SDL_GameController *controller = SDL_GameControllerOpen(0);
-    if (controller == NULL) {
-        printf("Impossible d'ouvrir la manette : %s\n", SDL_GetError());
-        SDL_Quit();
-        return -1;
+    
+    if (benchmark) {
+        // Pas de manette : chaque robot reçoit les évènements d'une manette simulée
+        bench.targets = fleet.count;
+        for (int i = 0; i < fleet.count; i++) {
+            fleet.links[i].joystick = i;
+        }
+        printf("Banc d'essai vers %s%s\n", fleet.links[0].name, fleet.count > 1 ? " et les autres robots" : "");
+    } else {
+        printf("Recherche de manettes...\n");
+        if (SDL_NumJoysticks() < 1) {
+            printf("Aucune manette détectée, en attente d'une manette.\n");
+        }
     }
-    printf("Manette detecter : %s\nConnexion à l'ESP32...\n", SDL_GameControllerName(controller));
     
-    // Initialisation de la connexion avec l'ESP32
-    int sock = 0;
-    struct sockaddr_in serv_addr;
-    char buffer[1024] = {0};
+    // Injection locale : un slot par processus et par robot, fusionné à chaque envoi
+    struct inject_shm *inject = NULL;
+    if (inject_name[0]) {
+        inject = inject_map(inject_name, 1);
+        if (inject == NULL) {
+            printf("Impossible de créer la mémoire partagée %s : %s\n", inject_name, strerror(errno));
+            return -1;
+        }
+        inject->robots = fleet.count;
+        for (int i = 0; i < fleet.count; i++) {
+            snprintf(inject->robot_names[i], sizeof(inject->robot_names[i]), "%s", fleet.links[i].name);
+            fleet.links[i].inject = inject;
+            fleet.links[i].inject_robot = i;
+            fleet.links[i].takeover_button = takeover_button;
+        }
+        printf("Injection locale ouverte dans %s, reprise manuelle avec %s\n", inject_name,
+               control_button_name[takeover_button].text);
+    }
     
-    // Create socket
-    if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-        printf("Erreur de creation socket\n");
-        return -1;
+    // Initialisation de la connexion avec les ESP32
+    printf("Connexion %s...\n", fleet.count > 1 ? "aux robots" : "à l'ESP32");
+    // Un robot injoignable n'empêche pas de démarrer : il est retenté en tâche de fond
+    for (int i = 0; i < fleet.count; i++) {
+        pthread_mutex_init(&fleet.links[i].io_lock, NULL);
+        link_connect(&fleet.links[i], CONNECT_WAIT_MS);
+        fleet.links[i].stats.start_ns = stats_now_ns();
+        fleet.links[i].heard_at = SDL_GetTicks(); // premier délai de réponse du robot
     }
     
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(PORT);
+    // Enregistrement de la session du premier robot, avant le thread d'envoi qui y écrit aussi
+    if (log_path != NULL) {
+        if (session_log_open(&log, log_path) != EXIT_SUCCESS) {
+            printf("Impossible d'enregistrer dans %s\n", log_path);
+            return -1;
+        }
+        fleet.links[0].log = &log;
+    }
     
+    // Lance le thread d'envoi cadencé, un seul pour tous les robots
+    if (model.rate_hz > 0) {
+        atomic_store(&fleet.sender_running, 1);
+        if (pthread_create(&fleet.sender, NULL, sender_thread, &fleet) != 0) {
+            printf("Impossible de lancer le thread d'envoi\n");
+            return -1;
+        }
+        printf("Envoi cadencé à %d Hz\n", model.rate_hz);
+    }
     
-    // Convertit l'adresse IP V4 et V6 en forme binaire
-    if (inet_pton(AF_INET, SERVER_IP, &serv_addr.sin_addr) <= 0) {
-        printf("Address invalid/ Address non supportee\n");
+    // Surveille les sockets depuis un thread pour ne jamais tourner à vide
+    struct watcher watcher;
+    if (watcher_start(&watcher) != EXIT_SUCCESS) {
+        printf("Impossible de surveiller les sockets\n");
         return -1;
     }
-    
-    // Connect à l'ESP32
-    if (connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
-        printf("Connection Echouée\n");
+    for (int i = 0; i < fleet.count; i++) {
+        struct link *link = &fleet.links[i];
+        link->watch_out = link_wants_out(link);
+        if (link->sock >= 0 && watcher_add(&watcher, link->sock, link->watch_out) != EXIT_SUCCESS) {
+            printf("Impossible de surveiller la socket de %s\n", link->name);
+            return -1;
+        }
+    }
+    // Entrée au clavier : affiche les statistiques
+    if (watcher_add(&watcher, STDIN_FILENO, 0) == EXIT_SUCCESS) {
+        printf("Appuyez sur Entrée pour afficher les statistiques\n");
+    }
+    if (benchmark && bench_start(&bench) != EXIT_SUCCESS) {
+        printf("Impossible de lancer l'injection\n");
+        return -1;
+    }
+    // Temps réel une fois tous les threads lancés : seuls ceux de la boucle et de l'envoi en profitent
+    if ((rt_priority > 0 || rt_cpu >= 0) && realtime_start(&fleet, &watcher, rt_priority, rt_cpu) != EXIT_SUCCESS) {
         return -1;
     }
-    printf("Connexion établie avec l'ESP32 !\n");
-    
-    
-    SDL_GameControllerRumble(controller, 0.5, 1, 500); // Fait vibrer la manette
-    SDL_GameControllerSetLED(controller, 0x00, 0xFF, 0x00); // Allume la LED de la manette en vert
     
-    // Boucle principale
+    // Boucle principale : dort jusqu'au prochain évènement manette, socket ou timer
     int running = 1;
+    unsigned long long inputs = 0; // évènements manette traités, pour le rejeu
     SDL_Event event;
     while (running) {
-        while (SDL_PollEvent(&event)) {
-            switch (event.type) {
-            case SDL_CONTROLLERAXISMOTION: // Mouvement des joystick
-                joystick(event, sock);
-                break;
-            
-            case SDL_CONTROLLERBUTTONDOWN: // Boutons appuyés
-                press_button(event, sock);
-                break;
-            
-            case SDL_CONTROLLERBUTTONUP: // Boutons relâchés
-                release_button(event, sock);
-                break;
-            
-            case SDL_QUIT: // Quitte l'application
-                printf("SDL_QUIT trigger\n");
-                running = 0;
-                break;
-            }
+        if (SDL_WaitEventTimeout(&event, fleet_timeout_ms(&fleet))) {
+            do {
+                switch (event.type) {
+                case SDL_CONTROLLERAXISMOTION: // Mouvement des joystick
+                case SDL_CONTROLLERBUTTONDOWN: // Boutons appuyés
+                case SDL_CONTROLLERBUTTONUP: // Boutons relâchés
+                    dispatch_input(&fleet, event);
+                    inputs++;
+                    break;
+                
+                case SDL_CONTROLLERSENSORUPDATE: // Gyroscope et accéléromètre (-g)
+                case SDL_CONTROLLERTOUCHPADDOWN: // Pavé tactile
+                case SDL_CONTROLLERTOUCHPADMOTION:
+                case SDL_CONTROLLERTOUCHPADUP:
+                    dispatch_motion(&fleet, event);
+                    break;
+                
+                case SDL_CONTROLLERDEVICEADDED: // Manette branchée, y compris celles présentes au lancement
+                    if (!benchmark) {
+                        fleet_attach(&fleet, event.cdevice.which);
+                    }
+                    break;
+                
+                case SDL_CONTROLLERDEVICEREMOVED: // Manette débranchée : son robot s'arrête
+                    if (!benchmark) {
+                        fleet_detach(&fleet, event.cdevice.which);
+                    }
+                    break;
+                
+                case SDL_QUIT: // Quitte l'application
+                    printf("SDL_QUIT trigger\n");
+                    running = 0;
+                    break;
+                
+                default:
+                    if (event.type == watcher.event_type && event.user.code == STDIN_FILENO) { // Touche Entrée
+                        char line[64];
+                        if (read(STDIN_FILENO, line, sizeof(line)) > 0) {
+                            fleet_stats_print(&fleet, stdout);
+                            watcher_rearm(&watcher, STDIN_FILENO, 0);
+                        }
+                    } else if (event.type == watcher.event_type) { // Socket d'un ESP32 prête
+                        struct link *link = fleet_find_socket(&fleet, event.user.code);
+                        if (link != NULL) {
+                            link_ready(link, (uint32_t)(uintptr_t)event.user.data1, &watcher);
+                        }
+                    }
+                    break;
+                }
+            } while (running && SDL_PollEvent(&event));
+        }
+        
+        // Réveil par des évènements ou un timer : une seule écriture par robot pour tout le tour
+        for (int i = 0; i < fleet.count; i++) {
+            link_timers(&fleet.links[i]);
+            link_inject(&fleet.links[i]);
+            link_flush(&fleet.links[i]);
+            link_heartbeat(&fleet.links[i]);
+            link_send_motion(&fleet.links[i]);
+            link_supervise(&fleet.links[i], &watcher);
+            link_feedback(&fleet.links[i]);
+            link_quality(&fleet.links[i]);
+        }
+        fleet_status(&fleet);
+        if (benchmark) {
+            bench_cycle_done(&bench, inputs);
         }
     }
+    watcher_stop(&watcher);
     
     // Fermeture et nettoyage
     printf("sortie du programme\n");
-    SDL_GameControllerClose(controller);
+    if (model.rate_hz > 0) {
+        atomic_store(&fleet.sender_running, 0);
+        pthread_join(fleet.sender, NULL);
+    }
+    if (fleet.links[0].log != NULL) {
+        fleet.links[0].log = NULL;
+        if (session_log_close(&log) != EXIT_SUCCESS) {
+            printf("Session incomplète dans %s (%llu enregistrements perdus)\n", log_path, log.dropped);
+        } else {
+            printf("Session enregistrée dans %s : %llu enregistrements, %llu octets\n", log_path, log.records, log.bytes);
+        }
+    }
+    if (benchmark) {
+        bench_stop(&bench);
+        fleet.tool_cpu_ns = bench_cpu_ns(&bench);
+        bench_print(&bench, stdout);
+    }
+    fleet_stats_print(&fleet, stdout);
+    if (csv_path != NULL && stats_csv(&fleet, csv_path) != EXIT_SUCCESS) {
+        printf("Impossible d'écrire %s\n", csv_path);
+    }
+    for (int i = 0; i < fleet.count; i++) {
+        if (fleet.links[i].sock >= 0) {
+            close(fleet.links[i].sock);
+        }
+        if (fleet.links[i].controller != NULL) {
+            SDL_GameControllerClose(fleet.links[i].controller);
+        }
+    }
+    if (inject != NULL) {
+        munmap(inject, sizeof(*inject));
+        shm_unlink(inject_name);
+    }
     SDL_Quit();
     return 0;
-}
\ No newline at end of file
+}
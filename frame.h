@@ -0,0 +1,447 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "controls.h"
+
+/**
+ * @file frame.h
+ * @brief Binary controller-state frame shared between the PC and the ESP32.
+ *
+ * A frame carries a full snapshot of the controller: a 16-bit button bitmask and
+ * the six raw axes as signed 16-bit integers, plus a sequence number. Every field
+ * is little-endian and written byte by byte, so the encoder does no formatting or
+ * heap work and the same header compiles on the ESP32 for the reference decoder.
+ *
+ * Layout of a state frame (FRAME_STATE_SIZE = 18 bytes):
+ * - [0]      FRAME_MAGIC
+ * - [1]      version (high nibble) | type (low nibble)
+ * - [2..3]   sequence number (uint16, wraps around)
+ * - [4..5]   button bitmask (bit n = SDL_CONTROLLER_BUTTON n)
+ * - [6..17]  axes LX, LY, RX, RY, L2, R2 (int16, full scale ±32767)
+ *
+ * The robot answers each state frame with an ACK frame: just the 4-byte header,
+ * with the sequence number of the frame it acknowledges.
+ *
+ * A heartbeat frame is the 4-byte header alone, type FRAME_TYPE_HEARTBEAT, numbered
+ * like the state frames. The PC sends it when it has nothing else to send, so that
+ * the robot can tell an idle operator from a dead link (struct frame_watchdog); the
+ * robot acknowledges it like a state frame.
+ *
+ * The robot may also stream telemetry frames (FRAME_TELEMETRY_SIZE = 14 bytes),
+ * numbered by their own sequence:
+ * - [0..3]   header, type FRAME_TYPE_TELEMETRY
+ * - [4..5]   battery voltage in mV (uint16)
+ * - [6]      battery charge in % (uint8, estimated by the robot, it knows its cells)
+ * - [7]      temperature in °C (int8)
+ * - [8..11]  left and right motor currents in mA (int16, negative when braking)
+ * - [12..13] fault bitmask (FRAME_FAULT_*)
+ *
+ * Motion frames carry the gyroscope, accelerometer and touchpad of the controller,
+ * several samples per frame (FRAME_MOTION_SIZE(n) bytes), numbered by their own
+ * sequence:
+ * - [0..3]   header, type FRAME_TYPE_MOTION
+ * - [4]      number of samples n, 0 to FRAME_MOTION_MAX (0: only the touchpad changed)
+ * - [5]      touchpad: bit f = finger f down
+ * - [6..9]   controller timestamp of the first sample in µs (uint32, wraps around)
+ * - [10..17] touchpad fingers 0 and 1, x then y (uint16, 0 = left/top, 65535 = right/bottom)
+ * - then n samples of FRAME_MOTION_SAMPLE_SIZE bytes: µs since the first sample
+ *   (uint16), gyroscope x, y, z (int16, FRAME_GYRO_SCALE per rad/s), accelerometer
+ *   x, y, z (int16, FRAME_ACCEL_SCALE per m/s²), in SDL's sensor axes
+ *
+ * Button bits and axis indices come from controls.h, which also holds the text
+ * protocol; frame_apply_text() applies a text message to the same state.
+ *
+ * Header only: include it on both sides, nothing to link.
+ */
+
+#define FRAME_MAGIC 0xA5
+#define FRAME_VERSION 1
+
+#define FRAME_TYPE_STATE 0x1
+#define FRAME_TYPE_ACK 0x2
+#define FRAME_TYPE_TELEMETRY 0x3
+#define FRAME_TYPE_MOTION 0x4
+#define FRAME_TYPE_HEARTBEAT 0x5
+
+#define FRAME_HEADER_SIZE 4
+#define FRAME_STATE_SIZE (FRAME_HEADER_SIZE + 2 + 2 * FRAME_AXIS_COUNT)
+#define FRAME_TELEMETRY_SIZE (FRAME_HEADER_SIZE + 10)
+#define FRAME_MOTION_MAX 8 // échantillons par trame de mouvement au plus
+#define FRAME_MOTION_SAMPLE_SIZE 14
+#define FRAME_MOTION_SIZE(n) (FRAME_HEADER_SIZE + 14 + (n) * FRAME_MOTION_SAMPLE_SIZE)
+#define FRAME_MAX_SIZE FRAME_MOTION_SIZE(FRAME_MOTION_MAX) // plus grande trame, dans un sens ou dans l'autre
+
+#define FRAME_GYRO_SCALE 1000.0f // pas de 1 mrad/s, jusqu'à ±32 rad/s
+#define FRAME_ACCEL_SCALE 100.0f // pas de 0,01 m/s², jusqu'à ±33 g
+
+// Bits des défauts signalés par la télémétrie
+enum frame_fault {
+    FRAME_FAULT_BATTERY = 1 << 0,       // batterie faible
+    FRAME_FAULT_OVERCURRENT = 1 << 1,   // surintensité d'un moteur
+    FRAME_FAULT_OVERHEAT = 1 << 2,      // surchauffe
+    FRAME_FAULT_STALL = 1 << 3,         // moteur bloqué
+    FRAME_FAULT_COUNT = 4
+};
+
+static const char *const frame_fault_names[FRAME_FAULT_COUNT] = { "batterie", "surintensité", "surchauffe", "blocage" };
+
+/**
+ * @brief Snapshot of every input forwarded to the robot.
+ */
+struct controller_state {
+    uint16_t buttons;                 // bit n = bouton n appuyé
+    int16_t axes[FRAME_AXIS_COUNT];   // valeurs brutes SDL (-32768..32767, 0..32767 pour les gâchettes)
+};
+
+/**
+ * @brief Robot status carried by a telemetry frame.
+ */
+struct telemetry {
+    uint16_t battery_mv;
+    uint8_t battery_pct;
+    int8_t temperature_c;
+    int16_t current_ma[2];            // moteur gauche, moteur droit
+    uint16_t faults;                  // FRAME_FAULT_*
+};
+
+/**
+ * @brief One quantized sample of the controller's motion sensors.
+ */
+struct motion_sample {
+    uint16_t offset_us;               // depuis le premier échantillon de la trame
+    int16_t gyro[3];                  // FRAME_GYRO_SCALE par rad/s
+    int16_t accel[3];                 // FRAME_ACCEL_SCALE par m/s²
+};
+
+/**
+ * @brief A batch of motion samples and the touchpad fingers, as carried by a motion frame.
+ */
+struct motion {
+    uint8_t count;
+    uint8_t touch;                    // bit f : doigt f posé
+    uint32_t time_us;                 // horodatage du premier échantillon
+    uint16_t finger[2][2];            // x, y de chaque doigt
+    struct motion_sample samples[FRAME_MOTION_MAX];
+};
+
+/**
+ * @brief A decoded frame.
+ */
+struct frame {
+    uint8_t type;
+    uint16_t seq;
+    struct controller_state state;    // trames FRAME_TYPE_STATE
+    struct telemetry telemetry;       // trames FRAME_TYPE_TELEMETRY
+    struct motion motion;             // trames FRAME_TYPE_MOTION
+};
+
+/**
+ * @brief Applies a text-protocol message to a controller state, for the ESP32 side.
+ *
+ * @param state (struct controller_state *) State to update.
+ * @param line (const char *) The message, with or without its "\n".
+ * @param len (size_t) Its length.
+ *
+ * @return Returns 1 if the message was known and applied, 0 otherwise.
+ */
+static inline int frame_apply_text(struct controller_state *state, const char *line, size_t len) {
+    struct control_message message;
+    if (!controls_decode_text(line, len, &message)) {
+        return 0;
+    }
+    switch (message.kind) {
+    case CONTROL_PRESS:
+        state->buttons |= (uint16_t)(1u << message.index);
+        break;
+    case CONTROL_RELEASE:
+        state->buttons &= (uint16_t)~(1u << message.index);
+        break;
+    case CONTROL_AXIS:
+        state->axes[message.index] = message.value;
+        break;
+    }
+    return 1;
+}
+
+static inline void frame_put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline uint16_t frame_get_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline size_t frame_put_header(uint8_t *out, uint8_t type, uint16_t seq) {
+    out[0] = FRAME_MAGIC;
+    out[1] = (uint8_t)((FRAME_VERSION << 4) | type);
+    frame_put_u16(out + 2, seq);
+    return FRAME_HEADER_SIZE;
+}
+
+/**
+ * @brief Encodes an ACK frame for the frame numbered `seq`.
+ *
+ * @return The number of bytes written, always FRAME_HEADER_SIZE.
+ */
+static inline size_t frame_encode_ack(uint8_t *out, uint16_t seq) {
+    return frame_put_header(out, FRAME_TYPE_ACK, seq);
+}
+
+/**
+ * @brief Encodes a heartbeat frame, numbered `seq` in the stream of state frames.
+ *
+ * @return The number of bytes written, always FRAME_HEADER_SIZE.
+ */
+static inline size_t frame_encode_heartbeat(uint8_t *out, uint16_t seq) {
+    return frame_put_header(out, FRAME_TYPE_HEARTBEAT, seq);
+}
+
+/**
+ * @brief Encodes a state frame into `out`.
+ *
+ * @param out (uint8_t *) Destination, at least FRAME_STATE_SIZE bytes.
+ * @param seq (uint16_t) Sequence number of the frame.
+ * @param state (const struct controller_state *) Snapshot to encode.
+ *
+ * @return The number of bytes written, always FRAME_STATE_SIZE.
+ */
+static inline size_t frame_encode_state(uint8_t *out, uint16_t seq, const struct controller_state *state) {
+    size_t n = frame_put_header(out, FRAME_TYPE_STATE, seq);
+    frame_put_u16(out + n, state->buttons);
+    n += 2;
+    for (int i = 0; i < FRAME_AXIS_COUNT; i++) {
+        frame_put_u16(out + n, (uint16_t)state->axes[i]);
+        n += 2;
+    }
+    return n;
+}
+
+/**
+ * @brief Encodes a telemetry frame into `out`, on the robot side.
+ *
+ * @param out (uint8_t *) Destination, at least FRAME_TELEMETRY_SIZE bytes.
+ * @param seq (uint16_t) Sequence number of the telemetry stream.
+ * @param telemetry (const struct telemetry *) Status to encode.
+ *
+ * @return The number of bytes written, always FRAME_TELEMETRY_SIZE.
+ */
+static inline size_t frame_encode_telemetry(uint8_t *out, uint16_t seq, const struct telemetry *telemetry) {
+    size_t n = frame_put_header(out, FRAME_TYPE_TELEMETRY, seq);
+    frame_put_u16(out + 4, telemetry->battery_mv);
+    out[6] = telemetry->battery_pct;
+    out[7] = (uint8_t)telemetry->temperature_c;
+    frame_put_u16(out + 8, (uint16_t)telemetry->current_ma[0]);
+    frame_put_u16(out + 10, (uint16_t)telemetry->current_ma[1]);
+    frame_put_u16(out + 12, telemetry->faults);
+    return n + 10;
+}
+
+/**
+ * @brief Encodes a motion frame into `out`.
+ *
+ * @param out (uint8_t *) Destination, at least FRAME_MOTION_SIZE(motion->count) bytes.
+ * @param seq (uint16_t) Sequence number of the motion stream.
+ * @param motion (const struct motion *) Samples to encode, 0 to FRAME_MOTION_MAX.
+ *
+ * @return The number of bytes written.
+ */
+static inline size_t frame_encode_motion(uint8_t *out, uint16_t seq, const struct motion *motion) {
+    size_t n = frame_put_header(out, FRAME_TYPE_MOTION, seq);
+    out[n++] = motion->count;
+    out[n++] = motion->touch;
+    frame_put_u16(out + n, (uint16_t)motion->time_us);
+    frame_put_u16(out + n + 2, (uint16_t)(motion->time_us >> 16));
+    n += 4;
+    for (int f = 0; f < 2; f++) {
+        frame_put_u16(out + n, motion->finger[f][0]);
+        frame_put_u16(out + n + 2, motion->finger[f][1]);
+        n += 4;
+    }
+    for (int i = 0; i < motion->count; i++) {
+        const struct motion_sample *sample = &motion->samples[i];
+        frame_put_u16(out + n, sample->offset_us);
+        for (int k = 0; k < 3; k++) {
+            frame_put_u16(out + n + 2 + 2 * k, (uint16_t)sample->gyro[k]);
+            frame_put_u16(out + n + 8 + 2 * k, (uint16_t)sample->accel[k]);
+        }
+        n += FRAME_MOTION_SAMPLE_SIZE;
+    }
+    return n;
+}
+
+/**
+ * @brief Reference decoder: parses one frame at the start of `buf`.
+ *
+ * Works the same on a TCP byte stream and on a UDP datagram. On a stream, call it
+ * in a loop and drop one byte whenever it returns -1 to resynchronise on the next
+ * FRAME_MAGIC.
+ *
+ * @param buf (const uint8_t *) Received bytes.
+ * @param len (size_t) Number of bytes available in `buf`.
+ * @param out (struct frame *) Decoded frame, valid only when the return value is > 0.
+ *
+ * @return The size of the decoded frame, 0 if more bytes are needed, or -1 if
+ *         `buf` does not start with a valid frame.
+ */
+static inline int frame_decode(const uint8_t *buf, size_t len, struct frame *out) {
+    if (len < FRAME_HEADER_SIZE) {
+        return (len > 0 && buf[0] != FRAME_MAGIC) ? -1 : 0;
+    }
+    if (buf[0] != FRAME_MAGIC || (buf[1] >> 4) != FRAME_VERSION) {
+        return -1;
+    }
+    out->type = buf[1] & 0x0F;
+    out->seq = frame_get_u16(buf + 2);
+
+    switch (out->type) {
+    case FRAME_TYPE_STATE:
+        if (len < FRAME_STATE_SIZE) {
+            return 0;
+        }
+        out->state.buttons = frame_get_u16(buf + 4);
+        for (int i = 0; i < FRAME_AXIS_COUNT; i++) {
+            out->state.axes[i] = (int16_t)frame_get_u16(buf + 6 + 2 * i);
+        }
+        return FRAME_STATE_SIZE;
+    case FRAME_TYPE_ACK:
+    case FRAME_TYPE_HEARTBEAT:
+        return FRAME_HEADER_SIZE;
+    case FRAME_TYPE_TELEMETRY:
+        if (len < FRAME_TELEMETRY_SIZE) {
+            return 0;
+        }
+        out->telemetry.battery_mv = frame_get_u16(buf + 4);
+        out->telemetry.battery_pct = buf[6];
+        out->telemetry.temperature_c = (int8_t)buf[7];
+        out->telemetry.current_ma[0] = (int16_t)frame_get_u16(buf + 8);
+        out->telemetry.current_ma[1] = (int16_t)frame_get_u16(buf + 10);
+        out->telemetry.faults = frame_get_u16(buf + 12);
+        return FRAME_TELEMETRY_SIZE;
+    case FRAME_TYPE_MOTION: {
+        if (len < FRAME_MOTION_SIZE(0)) {
+            return 0;
+        }
+        struct motion *motion = &out->motion;
+        motion->count = buf[4];
+        if (motion->count > FRAME_MOTION_MAX) {
+            return -1;
+        }
+        if (len < (size_t)FRAME_MOTION_SIZE(motion->count)) {
+            return 0;
+        }
+        motion->touch = buf[5];
+        motion->time_us = frame_get_u16(buf + 6) | ((uint32_t)frame_get_u16(buf + 8) << 16);
+        for (int f = 0; f < 2; f++) {
+            motion->finger[f][0] = frame_get_u16(buf + 10 + 4 * f);
+            motion->finger[f][1] = frame_get_u16(buf + 12 + 4 * f);
+        }
+        const uint8_t *p = buf + FRAME_MOTION_SIZE(0);
+        for (int i = 0; i < motion->count; i++, p += FRAME_MOTION_SAMPLE_SIZE) {
+            motion->samples[i].offset_us = frame_get_u16(p);
+            for (int k = 0; k < 3; k++) {
+                motion->samples[i].gyro[k] = (int16_t)frame_get_u16(p + 2 + 2 * k);
+                motion->samples[i].accel[k] = (int16_t)frame_get_u16(p + 8 + 2 * k);
+            }
+        }
+        return FRAME_MOTION_SIZE(motion->count);
+    }
+    default:
+        return -1;
+    }
+}
+
+/**
+ * @brief Receiver-side sequence tracking, needed when frames travel over UDP.
+ *
+ * Each frame is a full snapshot, so a frame older than the last one applied is
+ * worthless: it is dropped instead of moving the robot back in time. A frame more
+ * than FRAME_SEQ_WINDOW behind is taken as a restart of the PC and accepted.
+ */
+#define FRAME_SEQ_WINDOW 256
+
+struct frame_rx {
+    int synced;         // 0 tant qu'aucune trame n'a été acceptée
+    uint16_t last_seq;  // numéro de la dernière trame acceptée
+};
+
+/**
+ * @brief Tells whether a received frame is newer than the last accepted one.
+ *
+ * @param rx (struct frame_rx *) Receiver state, zero-initialised before the first frame.
+ * @param seq (uint16_t) Sequence number of the received frame.
+ *
+ * @return Returns 1 if the frame must be applied (and records it), 0 if it is a
+ *         duplicate or arrived out of order.
+ */
+static inline int frame_rx_accept(struct frame_rx *rx, uint16_t seq) {
+    int16_t diff = (int16_t)(seq - rx->last_seq);
+    if (rx->synced && diff <= 0 && diff > -FRAME_SEQ_WINDOW) {
+        return 0;
+    }
+    rx->synced = 1;
+    rx->last_seq = seq;
+    return 1;
+}
+
+/**
+ * @brief Robot-side watchdog: stops the robot when the PC goes silent.
+ *
+ * With -H, core_0.1.c never stays quiet longer than its heartbeat interval, even with
+ * the sticks held still. The watchdog is armed by the first heartbeat, so a PC
+ * without -H is never taken for a dead one. Feed it every frame received from the
+ * PC, stale ones included, and check it from the control loop: after `timeout_ms`
+ * without a frame it releases every button and centres every axis. The robot then
+ * stays stopped until the next state frame, which the PC sends as soon as it hears
+ * the robot again.
+ */
+#define FRAME_WATCHDOG_MS 100 // défaut : 4 battements de 25 ms
+
+struct frame_watchdog {
+    uint32_t timeout_ms;
+    uint32_t last_ms;   // dernière trame reçue du PC (millis() sur l'ESP32)
+    int armed;          // 1 : le PC envoie des battements
+    int tripped;        // 1 : robot arrêté, jusqu'à la prochaine trame d'état
+};
+
+/**
+ * @brief Records a frame received from the PC.
+ *
+ * @param watchdog (struct frame_watchdog *) Watchdog, `timeout_ms` set, the rest zero-initialised.
+ * @param type (uint8_t) Type of the received frame.
+ * @param now_ms (uint32_t) Current time in ms, wrapping around.
+ */
+static inline void frame_watchdog_feed(struct frame_watchdog *watchdog, uint8_t type, uint32_t now_ms) {
+    watchdog->last_ms = now_ms;
+    if (type == FRAME_TYPE_HEARTBEAT) {
+        watchdog->armed = 1;
+    } else if (type == FRAME_TYPE_STATE) {
+        watchdog->tripped = 0;
+    }
+}
+
+/**
+ * @brief Trips the watchdog if the PC has been silent for too long.
+ *
+ * @param watchdog (struct frame_watchdog *) Watchdog.
+ * @param now_ms (uint32_t) Current time in ms, wrapping around.
+ * @param state (struct controller_state *) State driving the robot, set to neutral on a trip.
+ *
+ * @return Returns 1 when the watchdog trips, 0 otherwise (also while it stays tripped).
+ */
+static inline int frame_watchdog_check(struct frame_watchdog *watchdog, uint32_t now_ms,
+                                       struct controller_state *state) {
+    if (!watchdog->armed || watchdog->tripped || now_ms - watchdog->last_ms < watchdog->timeout_ms) {
+        return 0;
+    }
+    watchdog->tripped = 1;
+    state->buttons = 0;
+    for (int i = 0; i < FRAME_AXIS_COUNT; i++) {
+        state->axes[i] = 0;
+    }
+    return 1;
+}
+
+#endif // FRAME_H
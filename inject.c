@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include "inject.h"
+// gcc -o inject inject.c -lrt
+// ./inject [-n /robot_inject] [-r robot] [-P priorité] [-t timeout_ms] [-N nom]
+
+/**
+ * @file inject.c
+ * @brief Command-line writer for the local injection of core_0.1.c (-i), see inject.h.
+ *
+ * Claims a slot of one robot and reads messages of the old text protocol on stdin,
+ * one per line: "JGX:0.50", "CroixP", "CroixR"... Each message takes the input it
+ * names and sets it; "libre" gives every input back to the controller. The state is
+ * rewritten every timeout / 2 so it stays fresh, and the slot is released at the end
+ * of stdin or on Ctrl-C.
+ *
+ * A script, a test or another language can drive the robot through it:
+ *
+ *     (echo JGY:0.50; sleep 2; echo JGY:0) | ./inject -r rouge -N essai
+ */
+
+static volatile sig_atomic_t running = 1;
+
+void stop(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+/**
+ * @brief Applies one line of stdin to the injected state and its masks.
+ *
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE if the line is not a known message.
+ */
+int apply_line(const char *line, size_t len, struct controller_state *state, uint16_t *buttons_mask,
+               uint8_t *axes_mask) {
+    if (len == 5 && memcmp(line, "libre", 5) == 0) {
+        memset(state, 0, sizeof(*state));
+        *buttons_mask = 0;
+        *axes_mask = 0;
+        return EXIT_SUCCESS;
+    }
+    struct control_message message;
+    if (!controls_decode_text(line, len, &message)) {
+        return EXIT_FAILURE;
+    }
+    if (message.kind == CONTROL_AXIS) {
+        *axes_mask |= (uint8_t)(1u << message.index);
+    } else {
+        *buttons_mask |= (uint16_t)(1u << message.index);
+    }
+    frame_apply_text(state, line, len);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[]) {
+    const char *shm_name = INJECT_DEFAULT_NAME;
+    const char *robot_name = "0";
+    const char *name = "inject";
+    int priority = 64;
+    int timeout_ms = INJECT_DEFAULT_TIMEOUT_MS;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:r:P:t:N:")) != -1) {
+        switch (opt) {
+        case 'n':
+            shm_name = optarg;
+            break;
+        case 'r':
+            robot_name = optarg;
+            break;
+        case 'P':
+            priority = atoi(optarg);
+            if (priority < 0 || priority > 255) {
+                printf("Priorité invalide : %s (0 à 255)\n", optarg);
+                return -1;
+            }
+            break;
+        case 't':
+            timeout_ms = atoi(optarg);
+            if (timeout_ms < 10 || timeout_ms > 60000) {
+                printf("Délai invalide : %s (10 à 60000 ms)\n", optarg);
+                return -1;
+            }
+            break;
+        case 'N':
+            name = optarg;
+            break;
+        default:
+            printf("Usage : %s [-n /robot_inject] [-r robot] [-P priorité] [-t timeout_ms] [-N nom]\n", argv[0]);
+            printf("  lit sur l'entrée standard des messages du protocole texte (JGX:0.50, CroixP, CroixR...)\n");
+            printf("  et \"libre\" pour rendre la main ; priorité %d et plus : passe avant la manette\n",
+                   INJECT_PRIORITY_OVERRIDE);
+            return -1;
+        }
+    }
+
+    struct inject_shm *shm = inject_map(shm_name, 0);
+    if (shm == NULL) {
+        printf("Impossible d'ouvrir %s : %s (core.exe a-t-il été lancé avec -i ?)\n", shm_name, strerror(errno));
+        return -1;
+    }
+    int robot = inject_find_robot(shm, robot_name);
+    if (robot < 0) {
+        printf("Robot inconnu : %s\n", robot_name);
+        return -1;
+    }
+    struct inject_writer writer;
+    if (inject_claim(&writer, shm, robot, name, priority, timeout_ms) != EXIT_SUCCESS) {
+        printf("Aucun slot libre pour %s (%d au plus)\n", shm->robot_names[robot], INJECT_SLOTS);
+        return -1;
+    }
+    printf("%s commande %s, priorité %d\n", name, shm->robot_names[robot], priority);
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    signal(SIGPIPE, SIG_IGN);
+
+    struct controller_state state = {0};
+    uint16_t buttons_mask = 0;
+    uint8_t axes_mask = 0;
+    char line[256];
+    size_t line_len = 0;
+    while (running) {
+        // Une ligne lue, ou rien pendant timeout / 2 : l'état est réécrit dans les deux cas
+        struct pollfd in = { STDIN_FILENO, POLLIN, 0 };
+        int ready = poll(&in, 1, timeout_ms / 2);
+        if (ready < 0 && errno != EINTR) {
+            break;
+        }
+        if (ready > 0) {
+            ssize_t n = read(STDIN_FILENO, line + line_len, sizeof(line) - line_len);
+            if (n <= 0) {
+                break;
+            }
+            line_len += (size_t)n;
+            char *start = line, *end;
+            while ((end = memchr(start, '\n', line_len - (size_t)(start - line))) != NULL) {
+                if (apply_line(start, (size_t)(end - start), &state, &buttons_mask, &axes_mask) != EXIT_SUCCESS
+                    && end > start) {
+                    printf("Message inconnu : %.*s\n", (int)(end - start), start);
+                }
+                start = end + 1;
+            }
+            line_len -= (size_t)(start - line);
+            memmove(line, start, line_len);
+            if (line_len == sizeof(line)) {
+                line_len = 0; // ligne trop longue pour un message : ignorée
+            }
+        }
+        inject_write(&writer, &state, buttons_mask, axes_mask);
+    }
+
+    inject_release(&writer);
+    printf("%s a rendu la main\n", name);
+    return 0;
+}
@@ -0,0 +1,337 @@
+#ifndef INJECT_H
+#define INJECT_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "frame.h"
+#include "stats.h"
+
+/**
+ * @file inject.h
+ * @brief Shared-memory command injection: local processes drive the robot through core_0.1.c.
+ *
+ * core_0.1.c (-i) creates one shared-memory segment with INJECT_SLOTS slots per
+ * robot. An autonomy or vision process on the same machine claims a slot and writes
+ * controller states into it; core_0.1.c merges them with the controller at send time
+ * and forwards the result over its single link to the robot. There is no socket, no
+ * copy through the kernel and no wake-up: each slot is a seqlock, the writer never
+ * waits and the reader retries a copy that was torn by a write.
+ *
+ * A slot only commands the inputs in its masks, at its priority, and only while it
+ * is fresh: a writer that stops writing for `timeout_ms` is ignored, so a crashed
+ * process loses control by itself. Writers must therefore rewrite their state at
+ * least every `timeout_ms`, even when it does not change.
+ *
+ * Merge rules, for each button and each axis (inject_merge()):
+ * - while the takeover button of the controller is held, only the controller counts;
+ * - otherwise the fresh slot of highest priority commanding the input wins, the lower
+ *   slot index on a tie, and the controller when no slot commands it;
+ * - a slot below INJECT_PRIORITY_OVERRIDE assists the operator: as soon as the
+ *   controller uses the input (button pressed, axis off centre), the controller wins.
+ *   A slot at or above it overrides the controller, e.g. an emergency stop from vision.
+ *
+ * Injected states are snapshots, like the binary frames: a press and release written
+ * between two sends is not seen.
+ *
+ * Header only, like session.h.
+ */
+
+#define INJECT_MAGIC 0x4A4E4943u   // "CINJ"
+#define INJECT_VERSION 1
+#define INJECT_ROBOTS 16            // robots décrits dans le segment, comme MAX_LINKS
+#define INJECT_SLOTS 4              // processus injecteurs par robot
+#define INJECT_PRIORITY_OVERRIDE 128 // à partir de cette priorité, l'injection passe avant la manette
+#define INJECT_DEFAULT_NAME "/robot_inject"
+#define INJECT_DEFAULT_TIMEOUT_MS 200
+#define INJECT_READ_TRIES 64         // copies déchirées tolérées avant de tenir le slot pour périmé
+
+/**
+ * @brief One injected controller state, written by one process.
+ *
+ * Everything after `owner` is protected by `seq`.
+ */
+struct inject_slot {
+    atomic_uint seq;                // impair pendant une écriture
+    atomic_int owner;               // pid de l'écrivain, 0 si le slot est libre
+    uint8_t priority;
+    uint16_t timeout_ms;            // l'état est ignoré s'il n'a pas été réécrit depuis
+    uint16_t buttons_mask;          // boutons commandés par ce slot
+    uint8_t axes_mask;              // bit n : axe n commandé
+    struct controller_state state;
+    uint64_t updated_ns;            // CLOCK_MONOTONIC de la dernière écriture (stats_now_ns())
+    char name[16];                  // nom de l'écrivain, pour les messages
+};
+
+/**
+ * @brief The shared-memory segment created by core_0.1.c.
+ */
+struct inject_shm {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t robots;                // robots pilotés par core_0.1.c
+    char robot_names[INJECT_ROBOTS][32];
+    struct inject_slot slots[INJECT_ROBOTS][INJECT_SLOTS];
+};
+
+/**
+ * @brief A consistent copy of a slot, as seen by the reader.
+ */
+struct inject_view {
+    int fresh;                      // 1 : réécrit depuis moins de timeout_ms
+    uint8_t priority;
+    uint16_t buttons_mask;
+    uint8_t axes_mask;
+    struct controller_state state;
+};
+
+/**
+ * @brief A process writing into one slot.
+ */
+struct inject_writer {
+    struct inject_shm *shm;
+    struct inject_slot *slot;
+};
+
+/**
+ * @brief Maps the segment `name`, created by core_0.1.c or by this call.
+ *
+ * @param name (const char *) shm_open() name, e.g. INJECT_DEFAULT_NAME.
+ * @param create (int) 1 for core_0.1.c: create and reset the segment.
+ *
+ * @return The mapping, or NULL (errno set; EPROTO if the segment is not an injection segment).
+ */
+static inline struct inject_shm *inject_map(const char *name, int create) {
+    int fd = shm_open(name, O_RDWR | (create ? O_CREAT | O_TRUNC : 0), 0660);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (create && ftruncate(fd, sizeof(struct inject_shm)) < 0) {
+        close(fd);
+        return NULL;
+    }
+    struct inject_shm *shm = mmap(NULL, sizeof(struct inject_shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) {
+        return NULL;
+    }
+    if (create) {
+        shm->version = INJECT_VERSION;
+        atomic_thread_fence(memory_order_release);
+        shm->magic = INJECT_MAGIC;
+    } else if (shm->magic != INJECT_MAGIC || shm->version != INJECT_VERSION) {
+        munmap(shm, sizeof(struct inject_shm));
+        errno = EPROTO;
+        return NULL;
+    }
+    return shm;
+}
+
+/**
+ * @brief Finds a robot of the segment by its name, or by its number ("0", "1"...).
+ *
+ * @return The robot index, or -1.
+ */
+static inline int inject_find_robot(const struct inject_shm *shm, const char *robot) {
+    for (uint32_t i = 0; i < shm->robots && i < INJECT_ROBOTS; i++) {
+        if (strcmp(shm->robot_names[i], robot) == 0) {
+            return (int)i;
+        }
+    }
+    char *end;
+    long index = strtol(robot, &end, 10);
+    return *robot != '\0' && *end == '\0' && index >= 0 && index < (long)shm->robots ? (int)index : -1;
+}
+
+/**
+ * @brief Claims the first free slot of a robot for the calling process.
+ *
+ * A slot whose owner process no longer exists is free again.
+ *
+ * @param writer (struct inject_writer *) Filled on success.
+ * @param shm (struct inject_shm *) The segment, from inject_map().
+ * @param robot (int) Robot index.
+ * @param name (const char *) Name of the writer, shown by core_0.1.c.
+ * @param priority (int) 0 to 255, see INJECT_PRIORITY_OVERRIDE.
+ * @param timeout_ms (int) The state is ignored if not rewritten for that long.
+ *
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE if every slot is taken.
+ */
+static inline int inject_claim(struct inject_writer *writer, struct inject_shm *shm, int robot, const char *name,
+                               int priority, int timeout_ms) {
+    int pid = (int)getpid();
+    for (int i = 0; i < INJECT_SLOTS; i++) {
+        struct inject_slot *slot = &shm->slots[robot][i];
+        int owner = atomic_load(&slot->owner);
+        if (owner != 0 && (kill(owner, 0) == 0 || errno != ESRCH)) {
+            continue;
+        }
+        if (!atomic_compare_exchange_strong(&slot->owner, &owner, pid)) {
+            continue;
+        }
+        // L'ancien propriétaire a pu mourir au milieu d'une écriture : seq repart d'une valeur paire
+        unsigned seq = (atomic_load_explicit(&slot->seq, memory_order_relaxed) + 1) & ~1u;
+        atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        slot->priority = (uint8_t)priority;
+        slot->timeout_ms = (uint16_t)timeout_ms;
+        slot->buttons_mask = 0;
+        slot->axes_mask = 0;
+        memset(&slot->state, 0, sizeof(slot->state));
+        slot->updated_ns = 0;
+        snprintf(slot->name, sizeof(slot->name), "%s", name);
+        atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+        writer->shm = shm;
+        writer->slot = slot;
+        return EXIT_SUCCESS;
+    }
+    return EXIT_FAILURE;
+}
+
+/**
+ * @brief Writes a new state into the slot of the writer. Never blocks.
+ *
+ * @param writer (struct inject_writer *) A claimed slot.
+ * @param state (const struct controller_state *) Buttons and axes, as the controller would report them.
+ * @param buttons_mask (uint16_t) Buttons commanded, 0 for none.
+ * @param axes_mask (uint8_t) Axes commanded (bit n = axis n), 0 for none.
+ */
+static inline void inject_write(struct inject_writer *writer, const struct controller_state *state,
+                                uint16_t buttons_mask, uint8_t axes_mask) {
+    struct inject_slot *slot = writer->slot;
+    unsigned seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->state = *state;
+    slot->buttons_mask = buttons_mask;
+    slot->axes_mask = axes_mask;
+    slot->updated_ns = stats_now_ns();
+    atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+}
+
+/**
+ * @brief Gives the slot back: its inputs return to the controller at once.
+ */
+static inline void inject_release(struct inject_writer *writer) {
+    struct controller_state neutral = {0};
+    inject_write(writer, &neutral, 0, 0);
+    atomic_store(&writer->slot->owner, 0);
+    munmap(writer->shm, sizeof(struct inject_shm));
+    writer->shm = NULL;
+    writer->slot = NULL;
+}
+
+/**
+ * @brief Reads a consistent copy of a slot.
+ *
+ * Gives up after INJECT_READ_TRIES torn copies: a writer killed in the middle of a
+ * write leaves `seq` odd until the slot is claimed again, and the reader must not
+ * spin on it (the sender thread holds a lock, maybe in SCHED_FIFO). The slot is then
+ * stale.
+ *
+ * @param slot (struct inject_slot *) The slot.
+ * @param now_ns (uint64_t) Current stats_now_ns(), to judge freshness.
+ * @param view (struct inject_view *) Receives the copy.
+ */
+static inline void inject_read(struct inject_slot *slot, uint64_t now_ns, struct inject_view *view) {
+    unsigned before, after;
+    uint64_t updated_ns;
+    uint16_t timeout_ms;
+    int tries = 0;
+    do {
+        if (tries++ == INJECT_READ_TRIES) {
+            view->fresh = 0;
+            return;
+        }
+        before = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        view->priority = slot->priority;
+        view->buttons_mask = slot->buttons_mask;
+        view->axes_mask = slot->axes_mask;
+        view->state = slot->state;
+        updated_ns = slot->updated_ns;
+        timeout_ms = slot->timeout_ms;
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    view->fresh = atomic_load(&slot->owner) != 0 && updated_ns != 0
+               && now_ns - updated_ns <= (uint64_t)timeout_ms * 1000000ull;
+}
+
+/**
+ * @brief Returns 1 if a process holds a slot of the robot, whether it writes or not.
+ */
+static inline int inject_claimed(struct inject_shm *shm, int robot) {
+    for (int i = 0; i < INJECT_SLOTS; i++) {
+        if (atomic_load_explicit(&shm->slots[robot][i].owner, memory_order_relaxed) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Merges the controller with the injected states of one robot (see the rules above).
+ *
+ * @param shm (struct inject_shm *) The segment.
+ * @param robot (int) Robot index.
+ * @param manual (const struct controller_state *) The controller state.
+ * @param takeover (int) 1 while the takeover button is held: the controller alone counts.
+ * @param now_ns (uint64_t) Current stats_now_ns().
+ * @param out (struct controller_state *) The merged state, may be `manual`.
+ *
+ * @return A bit per slot whose state was used, 0 if the controller alone counts.
+ */
+static inline unsigned inject_merge(struct inject_shm *shm, int robot, const struct controller_state *manual,
+                                    int takeover, uint64_t now_ns, struct controller_state *out) {
+    struct controller_state merged = *manual;
+    unsigned used = 0;
+    if (takeover) {
+        *out = merged;
+        return 0;
+    }
+    struct inject_view views[INJECT_SLOTS];
+    for (int i = 0; i < INJECT_SLOTS; i++) {
+        inject_read(&shm->slots[robot][i], now_ns, &views[i]);
+    }
+
+    for (int b = 0; b < FRAME_BTN_COUNT; b++) {
+        uint16_t bit = (uint16_t)(1u << b);
+        int best = -1;
+        for (int i = 0; i < INJECT_SLOTS; i++) {
+            if (views[i].fresh && (views[i].buttons_mask & bit) && (best < 0 || views[i].priority > views[best].priority)) {
+                best = i;
+            }
+        }
+        if (best < 0 || ((manual->buttons & bit) && views[best].priority < INJECT_PRIORITY_OVERRIDE)) {
+            continue;
+        }
+        merged.buttons = (uint16_t)((merged.buttons & ~bit) | (views[best].state.buttons & bit));
+        used |= 1u << best;
+    }
+    for (int a = 0; a < FRAME_AXIS_COUNT; a++) {
+        int best = -1;
+        for (int i = 0; i < INJECT_SLOTS; i++) {
+            if (views[i].fresh && (views[i].axes_mask & (1u << a))
+                && (best < 0 || views[i].priority > views[best].priority)) {
+                best = i;
+            }
+        }
+        if (best < 0 || (manual->axes[a] != 0 && views[best].priority < INJECT_PRIORITY_OVERRIDE)) {
+            continue;
+        }
+        merged.axes[a] = views[best].state.axes[a];
+        used |= 1u << best;
+    }
+    *out = merged;
+    return used;
+}
+
+#endif // INJECT_H
@@ -0,0 +1,628 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "frame.h"
+#include "stats.h"
+// gcc -o mock_robot mock_robot.c
+// ./mock_robot [-p port] [-l latence_ms] [-j gigue_ms] [-x perte_%] [-T hz] [-W ms] [-o arrivees.csv] [-v]
+
+#define PORT 8080
+#define MAX_PENDING 4096    // messages en attente de leur latence artificielle
+#define MAX_MESSAGE FRAME_MAX_SIZE // trame binaire ou ligne de texte
+#define TCP_RETRANSMIT_MS 200 // délai de réémission minimal de Linux
+
+// Batterie et moteurs simulés pour la télémétrie
+#define BATTERY_FULL_MV 12600   // 3S chargée
+#define BATTERY_EMPTY_MV 10500
+#define BATTERY_MAH 2200
+#define MOTOR_MAX_MA 9000       // courant d'un moteur joystick en butée
+#define BOOST_MA 3000           // surplus quand la gâchette droite est enfoncée
+#define OVERCURRENT_MA 10000
+#define RESISTANCE_MOHM 50      // chute de tension sous charge
+
+/**
+ * @file mock_robot.c
+ * @brief Stand-in for the ESP32, to test and benchmark core_0.1.c without a robot.
+ *
+ * Listens on TCP and UDP on the robot's port and decodes what core_0.1.c sends:
+ * binary frames (frame.h) and the old text protocol. Each state frame is answered
+ * with an ACK frame and each text line with "OK\n". Stale UDP frames are dropped
+ * with frame_rx_accept(), as the firmware would do.
+ *
+ * Bad Wi-Fi is simulated on reception: each message is lost with probability
+ * `loss`, or handed to the "robot" after `latency` ± `jitter` ms. Over UDP the
+ * jitter can reorder messages and a loss drops the datagram; over TCP order is
+ * kept and a loss costs a retransmission delay to that message and all the
+ * following ones, like on a real link.
+ *
+ * Every delivered message is written to the CSV file with its arrival time, and a
+ * summary with the inter-arrival histogram is printed on exit (Ctrl-C).
+ *
+ * With -T, telemetry frames are streamed back to the PC (TCP client, or the last
+ * UDP sender): the motor currents follow the left and right sticks, the battery
+ * drains with them, and pushing a stick to the end with the right trigger held
+ * raises an overcurrent fault. Telemetry is sent without the simulated latency.
+ *
+ * Motion frames (core_0.1.c -g) go through the same simulated link; they are
+ * counted apart and do not enter the inter-arrival histogram of the controls.
+ * Heartbeats (core_0.1.c -H) are acknowledged and counted apart too, and arm the
+ * watchdog of frame.h: when the PC then goes silent for -W ms, the "robot" stops.
+ */
+
+/**
+ * @brief A received message waiting for its artificial latency.
+ */
+struct pending {
+    uint64_t recv_ns;           // réception réelle
+    uint64_t due_ns;            // remise au "robot"
+    int udp;
+    int fd;                     // client TCP, ou socket UDP
+    struct sockaddr_in from;    // expéditeur UDP, pour l'acquittement
+    size_t len;
+    uint8_t data[MAX_MESSAGE];
+};
+
+/**
+ * @brief Min-heap of pending messages ordered by due time.
+ */
+struct delay_queue {
+    struct pending items[MAX_PENDING];
+    int count;
+};
+
+/**
+ * @brief Simulated link conditions and what the "robot" saw.
+ */
+struct robot {
+    double latency_ms;
+    double jitter_ms;
+    double loss;                // probabilité entre 0 et 1
+    int verbose;
+    FILE *csv;
+
+    struct delay_queue queue;
+    uint64_t last_tcp_due_ns;   // TCP ne double jamais : remises dans l'ordre
+    struct frame_rx rx;
+    struct controller_state state;
+
+    uint64_t start_ns;
+    uint64_t last_delivery_ns;
+    struct histogram gaps;      // intervalle entre deux remises, en µs
+    unsigned long long received, lost, stale, frames, texts, unknown, invalid;
+
+    int telemetry_hz;           // 0 : pas de télémétrie
+    uint16_t telemetry_seq;
+    double used_mah;            // charge consommée par les moteurs
+    int udp_peer;               // 1 : un PC a déjà envoyé un datagramme
+    struct sockaddr_in peer;    // son adresse, pour la télémétrie UDP
+    unsigned long long telemetry_sent;
+
+    struct frame_rx motion_rx;
+    unsigned long long motion_frames, motion_samples, motion_stale;
+
+    struct frame_watchdog watchdog; // armé par le premier battement du PC
+    unsigned long long heartbeats, watchdog_trips;
+};
+
+static volatile sig_atomic_t running = 1;
+
+void stop(int sig) {
+    (void)sig;
+    running = 0;
+}
+
+void queue_push(struct delay_queue *queue, const struct pending *item) {
+    int i = queue->count++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (queue->items[parent].due_ns <= item->due_ns) {
+            break;
+        }
+        queue->items[i] = queue->items[parent];
+        i = parent;
+    }
+    queue->items[i] = *item;
+}
+
+void queue_pop(struct delay_queue *queue, struct pending *item) {
+    *item = queue->items[0];
+    struct pending last = queue->items[--queue->count];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= queue->count) {
+            break;
+        }
+        if (child + 1 < queue->count && queue->items[child + 1].due_ns < queue->items[child].due_ns) {
+            child++;
+        }
+        if (last.due_ns <= queue->items[child].due_ns) {
+            break;
+        }
+        queue->items[i] = queue->items[child];
+        i = child;
+    }
+    queue->items[i] = last;
+}
+
+/**
+ * @brief Milliseconds for the watchdog, wrapping around like millis() on the ESP32.
+ */
+uint32_t robot_ms(uint64_t now_ns) {
+    return (uint32_t)(now_ns / 1000000);
+}
+
+/**
+ * @brief Acknowledges a state or heartbeat frame, even a late one: the PC times the round trip with it.
+ */
+void send_ack(struct pending *item, uint16_t seq) {
+    uint8_t ack[FRAME_HEADER_SIZE];
+    size_t len = frame_encode_ack(ack, seq);
+    if (item->udp) {
+        sendto(item->fd, ack, len, 0, (struct sockaddr *)&item->from, sizeof(item->from));
+    } else {
+        send(item->fd, ack, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+}
+
+/**
+ * @brief Hands a message to the "robot": decode, apply, acknowledge and log it.
+ */
+void deliver(struct robot *robot, struct pending *item, uint64_t now_ns) {
+    struct frame frame;
+    int binary = item->data[0] == FRAME_MAGIC && frame_decode(item->data, item->len, &frame) > 0;
+    if (binary) {
+        int tripped = robot->watchdog.tripped;
+        frame_watchdog_feed(&robot->watchdog, frame.type, robot_ms(now_ns));
+        if (tripped && !robot->watchdog.tripped) {
+            printf("Trame d'état reçue : le robot repart\n");
+        }
+    }
+    if (binary && frame.type == FRAME_TYPE_HEARTBEAT) {
+        robot->heartbeats++;
+        send_ack(item, frame.seq);
+        if (robot->verbose) {
+            printf("%s battement #%u\n", item->udp ? "udp" : "tcp", frame.seq);
+        }
+        return;
+    }
+    if (binary && frame.type == FRAME_TYPE_MOTION) {
+        // Mouvement : seulement compté, il ne pilote rien
+        if (!frame_rx_accept(&robot->motion_rx, frame.seq)) {
+            robot->motion_stale++;
+            return;
+        }
+        const struct motion *motion = &frame.motion;
+        robot->motion_frames++;
+        robot->motion_samples += motion->count;
+        if (robot->verbose) {
+            printf("%s mouvement #%u %u échantillons à %u µs", item->udp ? "udp" : "tcp", frame.seq, motion->count,
+                   motion->time_us);
+            if (motion->count > 0) {
+                const struct motion_sample *last = &motion->samples[motion->count - 1];
+                printf(" gyro=%.3f,%.3f,%.3f rad/s accel=%.2f,%.2f,%.2f m/s²", last->gyro[0] / FRAME_GYRO_SCALE,
+                       last->gyro[1] / FRAME_GYRO_SCALE, last->gyro[2] / FRAME_GYRO_SCALE,
+                       last->accel[0] / FRAME_ACCEL_SCALE, last->accel[1] / FRAME_ACCEL_SCALE,
+                       last->accel[2] / FRAME_ACCEL_SCALE);
+            }
+            for (int f = 0; f < 2; f++) {
+                if (motion->touch & (1u << f)) {
+                    printf(" doigt%d=%u,%u", f, motion->finger[f][0], motion->finger[f][1]);
+                }
+            }
+            printf("\n");
+        }
+        return;
+    }
+
+    if (robot->last_delivery_ns) {
+        hist_add(&robot->gaps, (now_ns - robot->last_delivery_ns) / 1000);
+    }
+    robot->last_delivery_ns = now_ns;
+    unsigned long long recv_us = (item->recv_ns - robot->start_ns) / 1000;
+    unsigned long long deliver_us = (now_ns - robot->start_ns) / 1000;
+    const char *transport = item->udp ? "udp" : "tcp";
+
+    if (binary) {
+        if (frame.type != FRAME_TYPE_STATE) {
+            return;
+        }
+        robot->frames++;
+        int applied = frame_rx_accept(&robot->rx, frame.seq);
+        if (applied) {
+            robot->state = frame.state;
+        } else {
+            robot->stale++;
+        }
+
+        send_ack(item, frame.seq);
+
+        const int16_t *axes = frame.state.axes;
+        if (robot->csv) {
+            fprintf(robot->csv, "%llu,%llu,%s,state,%u,%d,%u,%d,%d,%d,%d,%d,%d,\n", recv_us, deliver_us, transport,
+                    frame.seq, applied, frame.state.buttons, axes[0], axes[1], axes[2], axes[3], axes[4], axes[5]);
+        }
+        if (robot->verbose) {
+            printf("%s #%u%s boutons=0x%04x axes=%d,%d,%d,%d,%d,%d\n", transport, frame.seq, applied ? "" : " (périmée)",
+                   frame.state.buttons, axes[0], axes[1], axes[2], axes[3], axes[4], axes[5]);
+        }
+        return;
+    }
+
+    // Ancien protocole texte : une ligne "NOM:valeur" ou "BoutonP/R", décodée comme sur l'ESP32
+    robot->texts++;
+    int applied = frame_apply_text(&robot->state, (char *)item->data, item->len);
+    if (!applied) {
+        robot->unknown++;
+    }
+    item->data[item->len - 1] = '\0';
+    if (robot->csv) {
+        fprintf(robot->csv, "%llu,%llu,%s,text,,%d,,,,,,,,%s\n", recv_us, deliver_us, transport, applied,
+                (char *)item->data);
+    }
+    if (robot->verbose) {
+        printf("%s texte %s%s\n", transport, (char *)item->data, applied ? "" : " (inconnu)");
+    }
+    if (!item->udp) {
+        send(item->fd, "OK\n", 3, MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+}
+
+/**
+ * @brief Applies the simulated loss and latency to a received message.
+ */
+void receive_message(struct robot *robot, const uint8_t *data, size_t len, int udp, int fd,
+                     const struct sockaddr_in *from) {
+    robot->received++;
+    double delay_ms = robot->latency_ms;
+    if (robot->loss > 0 && (double)rand() / RAND_MAX < robot->loss) {
+        robot->lost++;
+        if (udp) {
+            return;
+        }
+        // TCP ne perd rien : le segment est réémis, et tout ce qui suit attend derrière
+        delay_ms += TCP_RETRANSMIT_MS;
+    }
+
+    struct pending item;
+    item.recv_ns = stats_now_ns();
+    if (robot->jitter_ms > 0) {
+        delay_ms += robot->jitter_ms * (2.0 * rand() / RAND_MAX - 1.0);
+    }
+    item.due_ns = item.recv_ns + (delay_ms > 0 ? (uint64_t)(delay_ms * 1e6) : 0);
+    if (!udp) {
+        if (item.due_ns < robot->last_tcp_due_ns) {
+            item.due_ns = robot->last_tcp_due_ns;
+        }
+        robot->last_tcp_due_ns = item.due_ns;
+    }
+    item.udp = udp;
+    item.fd = fd;
+    if (from) {
+        item.from = *from;
+    }
+    item.len = len < MAX_MESSAGE ? len : MAX_MESSAGE;
+    memcpy(item.data, data, item.len);
+
+    if (robot->queue.count == MAX_PENDING) {
+        // File pleine : on remet le plus ancien tout de suite
+        struct pending oldest;
+        queue_pop(&robot->queue, &oldest);
+        deliver(robot, &oldest, stats_now_ns());
+    }
+    queue_push(&robot->queue, &item);
+}
+
+/**
+ * @brief Splits received bytes into messages. Returns the number of bytes consumed.
+ *
+ * A binary frame starts with FRAME_MAGIC, anything else is a text line ending with
+ * '\n'. Bytes that fit neither are skipped one at a time to resynchronise.
+ */
+size_t split_messages(struct robot *robot, const uint8_t *buf, size_t len, int udp, int fd,
+                      const struct sockaddr_in *from) {
+    size_t pos = 0;
+    while (pos < len) {
+        struct frame frame;
+        if (buf[pos] == FRAME_MAGIC) {
+            int n = frame_decode(buf + pos, len - pos, &frame);
+            if (n == 0) {
+                break;
+            }
+            if (n < 0) {
+                robot->invalid++;
+                pos++;
+                continue;
+            }
+            receive_message(robot, buf + pos, n, udp, fd, from);
+            pos += n;
+            continue;
+        }
+        const uint8_t *end = memchr(buf + pos, '\n', len - pos);
+        if (end == NULL) {
+            if (len - pos >= MAX_MESSAGE) {
+                robot->invalid++;
+                pos++;
+                continue;
+            }
+            break;
+        }
+        receive_message(robot, buf + pos, end - (buf + pos) + 1, udp, fd, from);
+        pos = end - buf + 1;
+    }
+    return udp ? len : pos;
+}
+
+/**
+ * @brief Simulates the robot's status over the last `dt` seconds and sends it.
+ *
+ * @param robot (struct robot *) The robot.
+ * @param fd (int) TCP client, or the UDP socket to reply to the last sender.
+ * @param udp (int) 1 if `fd` is the UDP socket.
+ * @param dt (double) Seconds since the previous telemetry frame.
+ */
+void send_telemetry(struct robot *robot, int fd, int udp, double dt) {
+    struct telemetry telemetry = {0};
+    const int16_t *axes = robot->state.axes;
+    int boost = robot->state.axes[FRAME_AXIS_GD] > 16384 ? BOOST_MA : 0;
+    int16_t sticks[2] = { axes[FRAME_AXIS_JGY], axes[FRAME_AXIS_JDY] };
+    for (int i = 0; i < 2; i++) {
+        int current = (int)((long)sticks[i] * MOTOR_MAX_MA / 32767);
+        current += current < 0 ? -boost : (current > 0 ? boost : 0);
+        telemetry.current_ma[i] = (int16_t)current;
+        robot->used_mah += abs(current) * dt / 3600.0;
+        if (abs(current) >= OVERCURRENT_MA) {
+            telemetry.faults |= FRAME_FAULT_OVERCURRENT;
+        }
+    }
+    double charge = 1.0 - robot->used_mah / BATTERY_MAH;
+    charge = charge < 0 ? 0 : charge;
+    int load_ma = abs(telemetry.current_ma[0]) + abs(telemetry.current_ma[1]);
+    telemetry.battery_mv = (uint16_t)(BATTERY_EMPTY_MV + charge * (BATTERY_FULL_MV - BATTERY_EMPTY_MV)
+                                      - load_ma * RESISTANCE_MOHM / 1000);
+    telemetry.battery_pct = (uint8_t)(charge * 100);
+    telemetry.temperature_c = (int8_t)(30 + load_ma / 1000);
+    if (telemetry.battery_pct < 10) {
+        telemetry.faults |= FRAME_FAULT_BATTERY;
+    }
+
+    uint8_t frame[FRAME_TELEMETRY_SIZE];
+    size_t len = frame_encode_telemetry(frame, robot->telemetry_seq++, &telemetry);
+    if (udp) {
+        sendto(fd, frame, len, 0, (struct sockaddr *)&robot->peer, sizeof(robot->peer));
+    } else {
+        send(fd, frame, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+    robot->telemetry_sent++;
+}
+
+void print_summary(struct robot *robot) {
+    double elapsed = (stats_now_ns() - robot->start_ns) / 1e9;
+    printf("--- Robot simulé, %.1f s ---\n", elapsed);
+    printf("  reçus %llu, pertes simulées %llu, trames %llu dont %llu périmées,"
+           " lignes texte %llu dont %llu inconnues, octets invalides %llu\n",
+           robot->received, robot->lost, robot->frames, robot->stale, robot->texts, robot->unknown, robot->invalid);
+    hist_print(stdout, "intervalle_arrivees", &robot->gaps);
+    if (robot->telemetry_hz > 0) {
+        printf("  télémétrie envoyée %llu trames, charge consommée %.1f mAh\n", robot->telemetry_sent, robot->used_mah);
+    }
+    if (robot->heartbeats > 0) {
+        printf("  battements %llu, arrêts du chien de garde %llu\n", robot->heartbeats, robot->watchdog_trips);
+    }
+    if (robot->motion_frames > 0 || robot->motion_stale > 0) {
+        printf("  mouvement %llu trames, %llu échantillons, %llu trames périmées\n", robot->motion_frames,
+               robot->motion_samples, robot->motion_stale);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    static struct robot robot; // la file d'attente est trop grosse pour la pile
+    int port = PORT;
+    char *csv_path = NULL;
+    robot.watchdog.timeout_ms = FRAME_WATCHDOG_MS;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:l:j:x:T:W:o:v")) != -1) {
+        switch (opt) {
+        case 'p':
+            port = atoi(optarg);
+            break;
+        case 'l':
+            robot.latency_ms = atof(optarg);
+            break;
+        case 'j':
+            robot.jitter_ms = atof(optarg);
+            break;
+        case 'x':
+            robot.loss = atof(optarg) / 100;
+            break;
+        case 'T':
+            robot.telemetry_hz = atoi(optarg);
+            if (robot.telemetry_hz < 0 || robot.telemetry_hz > 10000) {
+                printf("Fréquence de télémétrie invalide : %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'W':
+            robot.watchdog.timeout_ms = (uint32_t)atoi(optarg);
+            if (atoi(optarg) <= 0) {
+                printf("Délai du chien de garde invalide : %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'o':
+            csv_path = optarg;
+            break;
+        case 'v':
+            robot.verbose = 1;
+            break;
+        default:
+            printf("Usage : %s [-p port] [-l latence_ms] [-j gigue_ms] [-x perte_%%] [-T hz] [-W ms] [-o arrivees.csv] [-v]\n", argv[0]);
+            return -1;
+        }
+    }
+    if (csv_path != NULL) {
+        robot.csv = fopen(csv_path, "w");
+        if (robot.csv == NULL) {
+            printf("Impossible d'ouvrir %s\n", csv_path);
+            return -1;
+        }
+        fputs("recv_us,deliver_us,transport,kind,seq,applied,buttons,lx,ly,rx,ry,l2,r2,text\n", robot.csv);
+    }
+
+    // Écoute TCP et UDP sur le port du robot
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    int one = 1;
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int udp = socket(AF_INET, SOCK_DGRAM, 0);
+    if (listener < 0 || udp < 0) {
+        printf("Erreur de creation socket\n");
+        return -1;
+    }
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listener, 4) < 0
+        || bind(udp, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        printf("Impossible d'écouter sur le port %d : %s\n", port, strerror(errno));
+        return -1;
+    }
+    printf("Robot simulé sur le port %d (TCP et UDP), latence %.1f ± %.1f ms, perte %.1f%%\n",
+           port, robot.latency_ms, robot.jitter_ms, robot.loss * 100);
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    robot.start_ns = stats_now_ns();
+
+    int client = -1;
+    uint8_t stream[4096];
+    size_t stream_len = 0;
+    uint64_t telemetry_period_ns = robot.telemetry_hz > 0 ? 1000000000ull / robot.telemetry_hz : 0;
+    uint64_t next_telemetry_ns = robot.start_ns + telemetry_period_ns;
+    uint64_t last_telemetry_ns = robot.start_ns;
+
+    while (running) {
+        // Dort jusqu'au prochain message ou à la prochaine remise différée
+        int timeout_ms = -1;
+        if (robot.queue.count > 0) {
+            uint64_t now = stats_now_ns();
+            uint64_t due = robot.queue.items[0].due_ns;
+            timeout_ms = due > now ? (int)((due - now + 999999) / 1000000) : 0;
+        }
+        if (telemetry_period_ns) {
+            uint64_t now = stats_now_ns();
+            int delay = next_telemetry_ns > now ? (int)((next_telemetry_ns - now) / 1000000) : 0;
+            timeout_ms = (timeout_ms < 0 || delay < timeout_ms) ? delay : timeout_ms;
+        }
+        if (robot.watchdog.armed && !robot.watchdog.tripped) {
+            uint32_t waited = robot_ms(stats_now_ns()) - robot.watchdog.last_ms;
+            int delay = waited < robot.watchdog.timeout_ms ? (int)(robot.watchdog.timeout_ms - waited) : 0;
+            timeout_ms = (timeout_ms < 0 || delay < timeout_ms) ? delay : timeout_ms;
+        }
+        struct pollfd fds[3] = {
+            { listener, POLLIN, 0 },
+            { udp, POLLIN, 0 },
+            { client, POLLIN, 0 },
+        };
+        if (poll(fds, client >= 0 ? 3 : 2, timeout_ms) < 0 && errno != EINTR) {
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            // Un seul PC à la fois, comme l'ESP32 : le nouveau remplace l'ancien
+            int fd = accept(listener, NULL, NULL);
+            if (fd >= 0) {
+                if (client >= 0) {
+                    close(client);
+                }
+                client = fd;
+                stream_len = 0;
+                robot.last_tcp_due_ns = 0;
+                robot.rx = (struct frame_rx){0}; // le PC repart de la trame 0
+                robot.motion_rx = (struct frame_rx){0};
+                robot.watchdog.armed = 0; // le nouveau PC n'envoie peut-être pas de battement
+                robot.watchdog.tripped = 0;
+                setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                printf("PC connecté en TCP\n");
+            }
+        }
+        if (fds[1].revents & POLLIN) {
+            uint8_t datagram[1500];
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            ssize_t n;
+            while ((n = recvfrom(udp, datagram, sizeof(datagram), MSG_DONTWAIT,
+                                 (struct sockaddr *)&from, &from_len)) > 0) {
+                split_messages(&robot, datagram, n, 1, udp, &from);
+                robot.peer = from;
+                robot.udp_peer = 1;
+                from_len = sizeof(from);
+            }
+        }
+        if (client >= 0 && (fds[2].revents & (POLLIN | POLLHUP | POLLERR))) {
+            ssize_t n = recv(client, stream + stream_len, sizeof(stream) - stream_len, 0);
+            if (n <= 0) {
+                printf("PC déconnecté\n");
+                close(client);
+                client = -1;
+            } else {
+                stream_len += n;
+                size_t used = split_messages(&robot, stream, stream_len, 0, client, NULL);
+                memmove(stream, stream + used, stream_len - used);
+                stream_len -= used;
+            }
+        }
+
+        // Remet au "robot" les messages dont la latence est écoulée
+        uint64_t now = stats_now_ns();
+        while (robot.queue.count > 0 && robot.queue.items[0].due_ns <= now) {
+            struct pending item;
+            queue_pop(&robot.queue, &item);
+            if (!item.udp && item.fd != client) {
+                continue; // connexion fermée entre temps
+            }
+            deliver(&robot, &item, now);
+        }
+
+        // Chien de garde : le PC s'est tu, le robot s'arrête
+        if (frame_watchdog_check(&robot.watchdog, robot_ms(now), &robot.state)) {
+            robot.watchdog_trips++;
+            printf("Chien de garde : aucune trame du PC depuis %u ms, robot arrêté\n",
+                   robot_ms(now) - robot.watchdog.last_ms);
+        }
+
+        // Télémétrie au rythme demandé, sans rattraper les ticks manqués
+        if (telemetry_period_ns && now >= next_telemetry_ns) {
+            double dt = (now - last_telemetry_ns) / 1e9;
+            last_telemetry_ns = now;
+            next_telemetry_ns += telemetry_period_ns;
+            if (next_telemetry_ns <= now) {
+                next_telemetry_ns = now + telemetry_period_ns;
+            }
+            if (client >= 0) {
+                send_telemetry(&robot, client, 0, dt);
+            } else if (robot.udp_peer) {
+                send_telemetry(&robot, udp, 1, dt);
+            }
+        }
+    }
+
+    print_summary(&robot);
+    if (robot.csv) {
+        fclose(robot.csv);
+    }
+    if (client >= 0) {
+        close(client);
+    }
+    close(listener);
+    close(udp);
+    return 0;
+}
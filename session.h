@@ -0,0 +1,337 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <SDL2/SDL.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "stats.h"
+
+/**
+ * @file session.h
+ * @brief Compact binary log of a controller session, for recording and replay.
+ *
+ * The log is a 16-byte header followed by records, all little-endian:
+ * - header: "MLOG", version (1 byte), 3 reserved bytes, start time (uint64, µs since 1970);
+ * - record: kind (1 byte), payload length (1 byte), time since the previous record
+ *   (uint32, µs), then the payload.
+ *
+ * Payloads:
+ * - SESSION_AXIS: axis (1 byte), value (int16);
+ * - SESSION_BUTTON: button (1 byte), 1 = pressed / 0 = released;
+ * - SESSION_SENT: the bytes of one outgoing frame or text line, as sent.
+ *
+ * Recording never blocks the caller: records are appended to a memory buffer under
+ * a mutex held for a memcpy, and a writer thread swaps buffers and writes the full
+ * one out. If the disk falls so far behind that the buffer fills up, records are
+ * dropped and counted rather than stalling the input loop.
+ *
+ * Replay maps the file and walks the records in place, without copying them.
+ *
+ * Header only, like stats.h.
+ */
+
+#define SESSION_MAGIC "MLOG"
+#define SESSION_VERSION 1
+#define SESSION_HEADER_SIZE 16
+#define SESSION_RECORD_HEADER 6
+#define SESSION_BUFFER (64 * 1024)  // par tampon, deux tampons en alternance
+#define SESSION_FLUSH_MS 50         // au plus 50 ms de session en mémoire
+
+enum session_kind { SESSION_AXIS = 1, SESSION_BUTTON = 2, SESSION_SENT = 3 };
+
+struct session_log {
+    int fd;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t writer;
+    int running;                    // protégé par lock
+    uint8_t *fill;                  // tampon rempli par les producteurs
+    uint8_t *spare;                 // tampon en cours d'écriture sur le disque
+    size_t len;
+    uint64_t last_ns;               // instant du dernier enregistrement
+    unsigned long long records;
+    unsigned long long dropped;     // tampon plein : enregistrements perdus
+    unsigned long long bytes;       // octets écrits dans le fichier
+    int failed;                     // 1 : une écriture sur le disque a échoué
+};
+
+static inline void session_put_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static inline uint32_t session_get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void *session_writer_thread(void *arg) {
+    struct session_log *log = arg;
+    pthread_mutex_lock(&log->lock);
+    for (;;) {
+        if (log->len == 0 && log->running) {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += SESSION_FLUSH_MS * 1000000L;
+            if (until.tv_nsec >= 1000000000L) {
+                until.tv_nsec -= 1000000000L;
+                until.tv_sec++;
+            }
+            pthread_cond_timedwait(&log->wake, &log->lock, &until);
+        }
+        if (log->len == 0 && !log->running) {
+            break;
+        }
+        // Échange les tampons : les producteurs continuent pendant l'écriture
+        uint8_t *full = log->fill;
+        size_t len = log->len;
+        log->fill = log->spare;
+        log->spare = full;
+        log->len = 0;
+        pthread_mutex_unlock(&log->lock);
+
+        size_t done = 0;
+        while (done < len) {
+            ssize_t n = write(log->fd, full + done, len - done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                log->failed = 1;
+                break;
+            }
+            done += n;
+        }
+        pthread_mutex_lock(&log->lock);
+        log->bytes += done;
+    }
+    pthread_mutex_unlock(&log->lock);
+    return NULL;
+}
+
+/**
+ * @brief Creates the log file, writes its header and starts the writer thread.
+ *
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE if the file or the thread could not be created.
+ */
+static inline int session_log_open(struct session_log *log, const char *path) {
+    memset(log, 0, sizeof(*log));
+    log->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    log->fill = malloc(SESSION_BUFFER);
+    log->spare = malloc(SESSION_BUFFER);
+    if (log->fd < 0 || log->fill == NULL || log->spare == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    uint8_t header[SESSION_HEADER_SIZE] = {0};
+    memcpy(header, SESSION_MAGIC, 4);
+    header[4] = SESSION_VERSION;
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    uint64_t start_us = (uint64_t)now.tv_sec * 1000000 + now.tv_usec;
+    session_put_u32(header + 8, (uint32_t)start_us);
+    session_put_u32(header + 12, (uint32_t)(start_us >> 32));
+    if (write(log->fd, header, sizeof(header)) != sizeof(header)) {
+        return EXIT_FAILURE;
+    }
+    log->bytes = sizeof(header);
+    log->last_ns = stats_now_ns();
+
+    pthread_mutex_init(&log->lock, NULL);
+    pthread_cond_init(&log->wake, NULL);
+    log->running = 1;
+    return pthread_create(&log->writer, NULL, session_writer_thread, log) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * @brief Appends one record. Never waits for the disk.
+ *
+ * @param log (struct session_log *) The log, or NULL when not recording.
+ * @param kind (enum session_kind) Kind of record.
+ * @param payload (const void *) Payload, truncated to 255 bytes.
+ * @param len (size_t) Payload length.
+ */
+static inline void session_log_record(struct session_log *log, enum session_kind kind, const void *payload, size_t len) {
+    if (log == NULL) {
+        return;
+    }
+    if (len > 255) {
+        len = 255;
+    }
+    uint64_t now = stats_now_ns();
+    pthread_mutex_lock(&log->lock);
+    if (log->len + SESSION_RECORD_HEADER + len > SESSION_BUFFER) {
+        log->dropped++;
+        pthread_mutex_unlock(&log->lock);
+        return;
+    }
+    // Le temps est pris sous le verrou pour rester croissant entre threads
+    uint64_t dt_us = now > log->last_ns ? (now - log->last_ns) / 1000 : 0;
+    log->last_ns += dt_us * 1000;
+    uint8_t *p = log->fill + log->len;
+    p[0] = (uint8_t)kind;
+    p[1] = (uint8_t)len;
+    session_put_u32(p + 2, dt_us > UINT32_MAX ? UINT32_MAX : (uint32_t)dt_us);
+    memcpy(p + SESSION_RECORD_HEADER, payload, len);
+    log->len += SESSION_RECORD_HEADER + len;
+    log->records++;
+    if (log->len > SESSION_BUFFER / 2) {
+        pthread_cond_signal(&log->wake);
+    }
+    pthread_mutex_unlock(&log->lock);
+}
+
+/**
+ * @brief Records a controller event. Other SDL events are ignored.
+ */
+static inline void session_log_event(struct session_log *log, const SDL_Event *event) {
+    uint8_t payload[3];
+    switch (event->type) {
+    case SDL_CONTROLLERAXISMOTION:
+        payload[0] = event->caxis.axis;
+        payload[1] = (uint8_t)event->caxis.value;
+        payload[2] = (uint8_t)((uint16_t)event->caxis.value >> 8);
+        session_log_record(log, SESSION_AXIS, payload, 3);
+        break;
+    case SDL_CONTROLLERBUTTONDOWN:
+    case SDL_CONTROLLERBUTTONUP:
+        payload[0] = event->cbutton.button;
+        payload[1] = event->type == SDL_CONTROLLERBUTTONDOWN;
+        session_log_record(log, SESSION_BUTTON, payload, 2);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Writes what is left in memory, stops the writer thread and closes the file.
+ *
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE if records were lost or a write failed.
+ */
+static inline int session_log_close(struct session_log *log) {
+    pthread_mutex_lock(&log->lock);
+    log->running = 0;
+    pthread_cond_signal(&log->wake);
+    pthread_mutex_unlock(&log->lock);
+    pthread_join(log->writer, NULL);
+    int failed = close(log->fd) != 0 || log->failed || log->dropped;
+    free(log->fill);
+    free(log->spare);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * @brief A log mapped in memory for replay.
+ */
+struct session_replay {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;                     // prochain enregistrement
+    uint64_t t_ns;                  // instant de l'enregistrement courant depuis le début
+};
+
+/**
+ * @brief One record, pointing into the mapped file.
+ */
+struct session_record {
+    enum session_kind kind;
+    uint8_t len;
+    const uint8_t *payload;
+    uint64_t t_ns;                  // depuis l'ouverture du journal
+};
+
+/**
+ * @brief Maps a log file read-only and checks its header.
+ *
+ * @return Returns EXIT_SUCCESS, or EXIT_FAILURE if the file cannot be read or is not a log.
+ */
+static inline int session_replay_open(struct session_replay *replay, const char *path) {
+    memset(replay, 0, sizeof(*replay));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return EXIT_FAILURE;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < SESSION_HEADER_SIZE) {
+        close(fd);
+        return EXIT_FAILURE;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return EXIT_FAILURE;
+    }
+    replay->data = data;
+    replay->size = st.st_size;
+    replay->pos = SESSION_HEADER_SIZE;
+    if (memcmp(replay->data, SESSION_MAGIC, 4) != 0 || replay->data[4] != SESSION_VERSION) {
+        munmap(data, st.st_size);
+        replay->data = NULL;
+        return EXIT_FAILURE;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Reads the next record.
+ *
+ * @return Returns 1 if `record` was filled, 0 at the end of the log. A record cut
+ *         short (program killed while recording) ends the log.
+ */
+static inline int session_replay_next(struct session_replay *replay, struct session_record *record) {
+    if (replay->pos + SESSION_RECORD_HEADER > replay->size) {
+        return 0;
+    }
+    const uint8_t *p = replay->data + replay->pos;
+    if (replay->pos + SESSION_RECORD_HEADER + p[1] > replay->size) {
+        return 0;
+    }
+    replay->t_ns += (uint64_t)session_get_u32(p + 2) * 1000;
+    record->kind = p[0];
+    record->len = p[1];
+    record->payload = p + SESSION_RECORD_HEADER;
+    record->t_ns = replay->t_ns;
+    replay->pos += SESSION_RECORD_HEADER + p[1];
+    return 1;
+}
+
+/**
+ * @brief Turns an axis or button record back into the SDL event it was recorded from.
+ *
+ * @return Returns 1 if `event` was filled, 0 for other kinds of records.
+ */
+static inline int session_record_event(const struct session_record *record, SDL_Event *event) {
+    memset(event, 0, sizeof(*event));
+    if (record->kind == SESSION_AXIS && record->len >= 3) {
+        event->type = SDL_CONTROLLERAXISMOTION;
+        event->caxis.axis = record->payload[0];
+        event->caxis.value = (Sint16)(record->payload[1] | (record->payload[2] << 8));
+        return 1;
+    }
+    if (record->kind == SESSION_BUTTON && record->len >= 2) {
+        event->type = record->payload[1] ? SDL_CONTROLLERBUTTONDOWN : SDL_CONTROLLERBUTTONUP;
+        event->cbutton.button = record->payload[0];
+        event->cbutton.state = record->payload[1];
+        return 1;
+    }
+    return 0;
+}
+
+static inline void session_replay_close(struct session_replay *replay) {
+    if (replay->data != NULL) {
+        munmap((void *)replay->data, replay->size);
+        replay->data = NULL;
+    }
+}
+
+#endif // SESSION_H
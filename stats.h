@@ -0,0 +1,133 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * @file stats.h
+ * @brief Monotonic timestamps and latency histograms for the PC-side tools.
+ *
+ * The histogram is log-linear: values below 8 µs have their own bucket, then each
+ * power of two is split in 8 buckets, so any value is known within 12.5% from 1 µs
+ * up to more than an hour, in a fixed 2 KB array. Adding a sample is a few integer
+ * operations and never allocates.
+ *
+ * Header only, like frame.h.
+ */
+
+#define HIST_SUB_BITS 3
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (HIST_SUB * (64 - HIST_SUB_BITS + 1))
+
+struct histogram {
+    uint64_t count;
+    uint64_t sum;       // µs
+    uint64_t max;       // µs
+    uint32_t buckets[HIST_BUCKETS];
+};
+
+/**
+ * @brief Current CLOCK_MONOTONIC time in nanoseconds.
+ */
+static inline uint64_t stats_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static inline int hist_bucket(uint64_t value) {
+    if (value < HIST_SUB) {
+        return (int)value;
+    }
+    int msb = 63 - __builtin_clzll(value);
+    int sub = (int)(value >> (msb - HIST_SUB_BITS)) & (HIST_SUB - 1);
+    return (msb - HIST_SUB_BITS + 1) * HIST_SUB + sub;
+}
+
+/**
+ * @brief Smallest value that falls in the bucket after `bucket`.
+ */
+static inline uint64_t hist_bucket_end(int bucket) {
+    if (bucket < HIST_SUB) {
+        return (uint64_t)bucket + 1;
+    }
+    int msb = bucket / HIST_SUB + HIST_SUB_BITS - 1;
+    uint64_t sub = (uint64_t)(bucket % HIST_SUB) + 1;
+    return (1ull << msb) + (sub << (msb - HIST_SUB_BITS));
+}
+
+static inline void hist_reset(struct histogram *hist) {
+    memset(hist, 0, sizeof(*hist));
+}
+
+/**
+ * @brief Records one sample, in microseconds.
+ */
+static inline void hist_add(struct histogram *hist, uint64_t value_us) {
+    hist->count++;
+    hist->sum += value_us;
+    if (value_us > hist->max) {
+        hist->max = value_us;
+    }
+    hist->buckets[hist_bucket(value_us)]++;
+}
+
+/**
+ * @brief Value below which `percent` % of the samples fall, in microseconds.
+ *
+ * Returns the upper bound of the bucket holding that sample, capped by the maximum.
+ */
+static inline uint64_t hist_percentile(const struct histogram *hist, double percent) {
+    if (hist->count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(hist->count * percent / 100.0);
+    if (rank >= hist->count) {
+        rank = hist->count - 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen > rank) {
+            uint64_t end = hist_bucket_end(i) - 1;
+            return end < hist->max ? end : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+static inline double hist_mean(const struct histogram *hist) {
+    return hist->count ? (double)hist->sum / hist->count : 0.0;
+}
+
+/**
+ * @brief Prints "name: n=... p50=... p99=... max=..." on one line.
+ */
+static inline void hist_print(FILE *out, const char *name, const struct histogram *hist) {
+    fprintf(out, "  %-22s n=%-8llu moy=%8.1f µs  p50=%6llu µs  p99=%6llu µs  max=%6llu µs\n",
+            name, (unsigned long long)hist->count, hist_mean(hist),
+            (unsigned long long)hist_percentile(hist, 50), (unsigned long long)hist_percentile(hist, 99),
+            (unsigned long long)hist->max);
+}
+
+/**
+ * @brief Writes one CSV row "latency,name,count,mean_us,p50_us,p99_us,max_us".
+ *
+ * Use STATS_CSV_HEADER as the first line of the file.
+ */
+#define STATS_CSV_HEADER "kind,name,count,mean_us,p50_us,p99_us,max_us\n"
+
+static inline void hist_csv(FILE *out, const char *name, const struct histogram *hist) {
+    fprintf(out, "latency,%s,%llu,%.1f,%llu,%llu,%llu\n", name, (unsigned long long)hist->count,
+            hist_mean(hist), (unsigned long long)hist_percentile(hist, 50),
+            (unsigned long long)hist_percentile(hist, 99), (unsigned long long)hist->max);
+}
+
+static inline void counter_csv(FILE *out, const char *name, unsigned long long value) {
+    fprintf(out, "counter,%s,%llu,,,,\n", name, value);
+}
+
+#endif // STATS_H
@@ -4,18 +4,22 @@
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/time.h>
 
 #define PORT 8080
 #define SERVER_IP "192.168.4.1" // Default IP for ESP32 in AP mode
 
-int main() {
+// Usage: ./wifi [-u]   (-u: UDP instead of TCP)
+int main(int argc, char *argv[]) {
     int sock = 0;
     struct sockaddr_in serv_addr;
     char *hello = "Hello from PC\n";
     char buffer[1024] = {0};
+    int udp = (argc > 1 && strcmp(argv[1], "-u") == 0);
     
     // Create socket
-    if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+    if ((sock = socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, 0)) < 0) {
         printf("Socket creation error\n");
         return -1;
     }
@@ -29,19 +33,33 @@ int main() {
         return -1;
     }
     
-    // Connect to the server
+    // Connect to the server (with UDP, only sets the default destination)
     if (connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
         printf("Connection Failed\n");
         return -1;
     }
     
+    if (udp) {
+        // A lost datagram is not retransmitted: do not wait forever for the reply
+        struct timeval timeout = { 1, 0 };
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    } else {
+        // Disable Nagle's algorithm so small messages leave immediately
+        int nodelay = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    }
+    
     // Send data to the server
     send(sock, hello, strlen(hello), 0);
     printf("Hello message sent\n");
     
     // Read response from the server
-    int valread = read(sock, buffer, 1024);
-    printf("Data received: %s\n", buffer);
+    int valread = read(sock, buffer, sizeof(buffer) - 1);
+    if (valread < 0) {
+        printf("No reply from the server\n");
+    } else {
+        printf("Data received: %s\n", buffer);
+    }
     
     // Close the socket
     close(sock);